@@ -0,0 +1,219 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * float_batch.c - branchless and SIMD array versions of the Data Lab
+ *     float routines (see float_batch.h)
+ *
+ * The scalar kernels turn each if of the lab routine into an all-ones or
+ * all-zeros mask and select with & and |; float_i2f finds the leading
+ * one with __builtin_clz instead of its while loop. The vector kernels
+ * do the same selects lane by lane, with the int <-> float conversions
+ * done by the conversion instructions: cvtdq2ps rounds to nearest even
+ * like float_i2f (MXCSR is left at its default), and cvttps2dq truncates
+ * and returns 0x80000000 for NaN, infinity and out of range like
+ * float_f2i. Everything the vector kernels use is in SSE2.
+ */
+#include "float_batch.h"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*All ones if cond, else 0*/
+#define MASK(cond) (-(unsigned)(cond))
+
+static inline unsigned abs_kernel(unsigned uf)
+{
+    unsigned abs = uf & 0x7FFFFFFF;
+
+    return abs | (uf & MASK(abs > 0x7F800000)); // NaN keeps its sign
+}
+
+static inline unsigned twice_kernel(unsigned uf)
+{
+    unsigned e = uf & 0x7F800000;
+    unsigned special = MASK(e == 0x7F800000);
+    unsigned denorm = MASK(e == 0);
+    unsigned r = (denorm & ((uf & 0x80000000) | (uf << 1))) | (~denorm & (uf + 0x00800000));
+
+    return (special & uf) | (~special & r);
+}
+
+/*
+ * i2f_kernel - Normalize |x| so its leading one is bit 31, keep 23 bits
+ *     below it and round the 8 under those to nearest even. A carry out
+ *     of the fraction runs into the exponent, as float_i2f's e++.
+ */
+static inline unsigned i2f_kernel(int x)
+{
+    unsigned neg = MASK(x < 0);
+    unsigned a = ((unsigned)x ^ neg) - neg;
+    int lz = __builtin_clz(a | 1); // a == 0 is masked out below
+    unsigned m = a << lz;
+    unsigned frac = (m >> 8) & 0x007FFFFF;
+    unsigned low = m & 0xFF;
+    unsigned up = (low > 128) | ((low == 128) & frac);
+    unsigned r = (neg & 0x80000000) + ((unsigned)(158 - lz) << 23) + frac + up;
+
+    return r & MASK(a != 0);
+}
+
+/*
+ * f2i_kernel - m * 2^(e - 150) with the hidden bit in m, shifting left or
+ *     right by whichever count is in range, then the sign; exponents
+ *     below 127 give 0, from 158 up 0x80000000
+ */
+static inline int f2i_kernel(unsigned uf)
+{
+    unsigned e = (uf >> 23) & 0xFF;
+    unsigned m = (uf & 0x007FFFFF) | 0x00800000;
+    unsigned big = MASK(e >= 150);
+    unsigned mag = (big & (m << ((e - 150) & 31))) | (~big & (m >> ((150 - e) & 31)));
+    unsigned neg = MASK(uf >> 31);
+    unsigned r = (mag ^ neg) - neg;
+    unsigned out = MASK(e >= 158);
+
+    return (int)((r & ~out & ~MASK(e < 127)) | (out & 0x80000000));
+}
+
+void float_abs_batch_scalar(const unsigned *in, unsigned *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = abs_kernel(in[i]);
+}
+
+void float_twice_batch_scalar(const unsigned *in, unsigned *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = twice_kernel(in[i]);
+}
+
+void float_i2f_batch_scalar(const int *in, unsigned *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = i2f_kernel(in[i]);
+}
+
+void float_f2i_batch_scalar(const unsigned *in, int *out, size_t n)
+{
+    for (size_t i = 0; i < n; i++)
+        out[i] = f2i_kernel(in[i]);
+}
+
+/*
+ * One set of vector kernels for both widths, written with the macros
+ * below; the tail of an array that does not fill a vector goes through
+ * the scalar kernels.
+ */
+#if defined(__AVX2__)
+#define LANES 8
+typedef __m256i vec;
+#define LOAD(p) _mm256_loadu_si256((const __m256i *)(p))
+#define STORE(p, v) _mm256_storeu_si256((__m256i *)(p), (v))
+#define SET1(x) _mm256_set1_epi32(x)
+#define AND(a, b) _mm256_and_si256(a, b)
+#define OR(a, b) _mm256_or_si256(a, b)
+#define ANDNOT(a, b) _mm256_andnot_si256(a, b) /* ~a & b */
+#define ADD(a, b) _mm256_add_epi32(a, b)
+#define SHL1(a) _mm256_slli_epi32(a, 1)
+#define CMPEQ(a, b) _mm256_cmpeq_epi32(a, b)
+#define CMPGT(a, b) _mm256_cmpgt_epi32(a, b)
+#define TOFLOAT(v) _mm256_castps_si256(_mm256_cvtepi32_ps(v))
+#define TOINT(v) _mm256_cvttps_epi32(_mm256_castsi256_ps(v))
+#elif defined(__SSE2__)
+#define LANES 4
+typedef __m128i vec;
+#define LOAD(p) _mm_loadu_si128((const __m128i *)(p))
+#define STORE(p, v) _mm_storeu_si128((__m128i *)(p), (v))
+#define SET1(x) _mm_set1_epi32(x)
+#define AND(a, b) _mm_and_si128(a, b)
+#define OR(a, b) _mm_or_si128(a, b)
+#define ANDNOT(a, b) _mm_andnot_si128(a, b) /* ~a & b */
+#define ADD(a, b) _mm_add_epi32(a, b)
+#define SHL1(a) _mm_slli_epi32(a, 1)
+#define CMPEQ(a, b) _mm_cmpeq_epi32(a, b)
+#define CMPGT(a, b) _mm_cmpgt_epi32(a, b)
+#define TOFLOAT(v) _mm_castps_si128(_mm_cvtepi32_ps(v))
+#define TOINT(v) _mm_cvttps_epi32(_mm_castsi128_ps(v))
+#else
+#define LANES 1
+#endif
+
+const int float_batch_lanes = LANES;
+
+#if LANES > 1
+/*b where mask is set, else a*/
+#define SELECT(mask, a, b) OR(AND(mask, b), ANDNOT(mask, a))
+
+void float_abs_batch(const unsigned *in, unsigned *out, size_t n)
+{
+    const vec magnitude = SET1(0x7FFFFFFF);
+    const vec inf = SET1(0x7F800000);
+    size_t i = 0;
+
+    for (; i + LANES <= n; i += LANES)
+    {
+        vec uf = LOAD(in + i);
+        vec abs = AND(uf, magnitude);
+        vec nan = CMPGT(abs, inf); // both non-negative as int
+
+        STORE(out + i, OR(abs, AND(nan, uf)));
+    }
+    float_abs_batch_scalar(in + i, out + i, n - i);
+}
+
+void float_twice_batch(const unsigned *in, unsigned *out, size_t n)
+{
+    const vec exp = SET1(0x7F800000);
+    const vec sign = SET1(0x80000000);
+    const vec one = SET1(0x00800000); // exponent + 1
+    const vec zero = SET1(0);
+    size_t i = 0;
+
+    for (; i + LANES <= n; i += LANES)
+    {
+        vec uf = LOAD(in + i);
+        vec e = AND(uf, exp);
+        vec r = SELECT(CMPEQ(e, zero), ADD(uf, one), OR(AND(uf, sign), SHL1(uf)));
+
+        STORE(out + i, SELECT(CMPEQ(e, exp), r, uf));
+    }
+    float_twice_batch_scalar(in + i, out + i, n - i);
+}
+
+void float_i2f_batch(const int *in, unsigned *out, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + LANES <= n; i += LANES)
+        STORE(out + i, TOFLOAT(LOAD(in + i)));
+    float_i2f_batch_scalar(in + i, out + i, n - i);
+}
+
+void float_f2i_batch(const unsigned *in, int *out, size_t n)
+{
+    size_t i = 0;
+
+    for (; i + LANES <= n; i += LANES)
+        STORE(out + i, TOINT(LOAD(in + i)));
+    float_f2i_batch_scalar(in + i, out + i, n - i);
+}
+#else
+void float_abs_batch(const unsigned *in, unsigned *out, size_t n)
+{
+    float_abs_batch_scalar(in, out, n);
+}
+
+void float_twice_batch(const unsigned *in, unsigned *out, size_t n)
+{
+    float_twice_batch_scalar(in, out, n);
+}
+
+void float_i2f_batch(const int *in, unsigned *out, size_t n)
+{
+    float_i2f_batch_scalar(in, out, n);
+}
+
+void float_f2i_batch(const unsigned *in, int *out, size_t n)
+{
+    float_f2i_batch_scalar(in, out, n);
+}
+#endif
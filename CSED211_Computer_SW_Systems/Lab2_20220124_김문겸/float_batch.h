@@ -0,0 +1,36 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * float_batch.h - array versions of float_abs, float_twice, float_i2f and
+ *     float_f2i from 20220124_kimmoonkyeom.c
+ *
+ * Every function here gives, element for element, the same bits as the
+ * Data Lab routine it is named after, special cases included (NaN in,
+ * NaN out; 0x80000000 for an f2i out of range; float_twice of the
+ * largest finite floats as the lab routine has it).
+ *
+ *     float_X_batch_scalar   one element at a time, without branches
+ *     float_X_batch          AVX2 (8 lanes) or SSE2 (4 lanes), whichever
+ *                            the build targets, scalar for the tail and
+ *                            without either
+ *
+ * in and out may be the same array, but must not overlap otherwise.
+ */
+#ifndef FLOAT_BATCH_H
+#define FLOAT_BATCH_H
+
+#include <stddef.h>
+
+void float_abs_batch_scalar(const unsigned *in, unsigned *out, size_t n);
+void float_twice_batch_scalar(const unsigned *in, unsigned *out, size_t n);
+void float_i2f_batch_scalar(const int *in, unsigned *out, size_t n);
+void float_f2i_batch_scalar(const unsigned *in, int *out, size_t n);
+
+void float_abs_batch(const unsigned *in, unsigned *out, size_t n);
+void float_twice_batch(const unsigned *in, unsigned *out, size_t n);
+void float_i2f_batch(const int *in, unsigned *out, size_t n);
+void float_f2i_batch(const unsigned *in, int *out, size_t n);
+
+/*Lanes of float_X_batch: 8, 4, or 1 without SIMD*/
+extern const int float_batch_lanes;
+
+#endif
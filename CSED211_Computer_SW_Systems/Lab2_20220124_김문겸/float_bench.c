@@ -0,0 +1,223 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * float_bench.c - checks float_batch.c bit for bit against the Data Lab
+ *     routines, then times all three versions of each
+ *
+ * build: gcc -O2 -fwrapv -march=native -o float_bench float_bench.c float_batch.c \
+ *            20220124_kimmoonkyeom.c
+ * usage: ./float_bench [-n <elements>] [-r <reps>] [-x]
+ *     -x  check every one of the 2^32 inputs instead of a random sample
+ *
+ * -fwrapv gives the lab routines the two's complement wraparound they
+ * were written for (as at -O0): without it float_i2f(INT_MIN) negates
+ * INT_MIN, which -O1 and up are free to turn into anything.
+ *
+ * Inputs are uniformly random bit patterns (random ints for i2f), so the
+ * lab routines' branches see every case mixed together, plus the edge
+ * cases: zeros, denormals, the largest finite floats, infinities, NaNs,
+ * and the ints around 0, INT_MIN and the 2^24 rounding boundaries.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include "float_batch.h"
+
+unsigned float_abs(unsigned uf);
+unsigned float_twice(unsigned uf);
+unsigned float_i2f(int x);
+int float_f2i(unsigned uf);
+
+static void ref_abs(const unsigned *in, unsigned *out, size_t n){
+
+    for(size_t i = 0; i < n; i++){
+        out[i] = float_abs(in[i]);
+    }
+}
+
+static void ref_twice(const unsigned *in, unsigned *out, size_t n){
+
+    for(size_t i = 0; i < n; i++){
+        out[i] = float_twice(in[i]);
+    }
+}
+
+static void ref_i2f(const unsigned *in, unsigned *out, size_t n){
+
+    for(size_t i = 0; i < n; i++){
+        out[i] = float_i2f((int)in[i]);
+    }
+}
+
+static void ref_f2i(const unsigned *in, unsigned *out, size_t n){
+
+    for(size_t i = 0; i < n; i++){
+        out[i] = (unsigned)float_f2i(in[i]);
+    }
+}
+
+/*i2f and f2i through the same unsigned-to-unsigned signature as abs and twice*/
+static void scalar_i2f(const unsigned *in, unsigned *out, size_t n){
+    float_i2f_batch_scalar((const int *)in, out, n);
+}
+static void scalar_f2i(const unsigned *in, unsigned *out, size_t n){
+    float_f2i_batch_scalar(in, (int *)out, n);
+}
+static void simd_i2f(const unsigned *in, unsigned *out, size_t n){
+    float_i2f_batch((const int *)in, out, n);
+}
+static void simd_f2i(const unsigned *in, unsigned *out, size_t n){
+    float_f2i_batch(in, (int *)out, n);
+}
+
+typedef void (*batch_fn)(const unsigned *in, unsigned *out, size_t n);
+
+struct{
+    const char *name;
+    batch_fn ref, scalar, simd;
+} funcs[] = {
+    {"float_abs", ref_abs, float_abs_batch_scalar, float_abs_batch},
+    {"float_twice", ref_twice, float_twice_batch_scalar, float_twice_batch},
+    {"float_i2f", ref_i2f, scalar_i2f, simd_i2f},
+    {"float_f2i", ref_f2i, scalar_f2i, simd_f2i},
+};
+#define NFUNCS (int)(sizeof(funcs) / sizeof(funcs[0]))
+
+unsigned edge[] = {
+    0x00000000, 0x80000000, 0x00000001, 0x80000001, 0x007FFFFF, 0x807FFFFF,
+    0x00400000, 0x00800000, 0x3F800000, 0xBF800000, 0x3F000000, 0x3FC00000,
+    0x4EFFFFFF, 0x4F000000, 0xCF000000, 0xCF000001, 0x7F000000, 0x7F7FFFFF,
+    0xFF7FFFFF, 0x7F800000, 0xFF800000, 0x7F800001, 0x7FC00000, 0xFFFFFFFF,
+    0x7FFFFFFF, 0x00FFFFFF, 0x01000000, 0x01000001, 0x01000003, 0xFEFFFFFF,
+    0x00FFFFFE, 0x40000000, 0x4B7FFFFF, 0x4B800000, 0xCB800001,
+};
+#define NEDGE (int)(sizeof(edge) / sizeof(edge[0]))
+
+static unsigned long long rng = 0x9E3779B97F4A7C15ull;
+
+static unsigned next_random(void){
+
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (unsigned)(rng >> 16);
+}
+
+static double now(void){
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*compare: 0 if the three versions agree on in[0..n), else report the first difference*/
+static int compare(int f, const unsigned *in, unsigned *a, unsigned *b, unsigned *c, size_t n){
+
+    funcs[f].ref(in, a, n);
+    funcs[f].scalar(in, b, n);
+    funcs[f].simd(in, c, n);
+    for(size_t i = 0; i < n; i++){
+        if(a[i] != b[i] || a[i] != c[i]){
+            printf("%s(0x%08x): lab 0x%08x, scalar 0x%08x, simd 0x%08x\n",
+                   funcs[f].name, in[i], a[i], b[i], c[i]);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char **argv){
+
+    size_t n = 1 << 20;
+    int reps = 20, exhaustive = 0, bad = 0;
+    unsigned *in, *a, *b, *c;
+    int opt;
+
+    while((opt = getopt(argc, argv, "n:r:x")) != -1){
+        switch(opt){
+        case 'n':
+            n = strtoul(optarg, NULL, 0);
+            break;
+        case 'r':
+            reps = atoi(optarg);
+            break;
+        case 'x':
+            exhaustive = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n <elements>] [-r <reps>] [-x]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(n < (size_t)NEDGE + 64){
+        n = NEDGE + 64;
+    }
+    in = malloc(n * sizeof(unsigned));
+    a = malloc(n * sizeof(unsigned));
+    b = malloc(n * sizeof(unsigned));
+    c = malloc(n * sizeof(unsigned));
+    if(!in || !a || !b || !c){
+        fprintf(stderr, "no memory for %zu elements\n", n);
+        return 1;
+    }
+
+    /* bit-identical check */
+    if(exhaustive){
+        for(int f = 0; f < NFUNCS && !bad; f++){
+            unsigned long long base;
+
+            for(base = 0; base < (1ull << 32) && !bad; base += n){
+                size_t len = (1ull << 32) - base < n ? (size_t)((1ull << 32) - base) : n;
+
+                for(size_t i = 0; i < len; i++){
+                    in[i] = (unsigned)(base + i);
+                }
+                bad = compare(f, in, a, b, c, len);
+            }
+        }
+    }
+    else{
+        memcpy(in, edge, sizeof(edge));
+        for(int i = 0; i < 64; i++){ // ints next to the 2^24..2^31 rounding steps
+            in[NEDGE + i] = (1u << (24 + i / 8)) + (i % 8) - 4;
+        }
+        for(size_t i = NEDGE + 64; i < n; i++){
+            in[i] = next_random();
+        }
+        for(int f = 0; f < NFUNCS; f++){
+            bad |= compare(f, in, a, b, c, n);
+            bad |= compare(f, in + 1, a, b, c, n - 1); // misaligned, other tail length
+        }
+    }
+    printf("check: %s, %s inputs, SIMD lanes %d\n", bad ? "MISMATCH" : "bit-identical",
+           exhaustive ? "all 2^32" : "edge and random", float_batch_lanes);
+    if(bad){
+        return 1;
+    }
+
+    /* throughput on random bit patterns */
+    for(size_t i = 0; i < n; i++){
+        in[i] = next_random();
+    }
+    printf("%-12s %14s %14s %14s %9s\n", "", "lab Melem/s", "scalar Melem/s", "simd Melem/s", "speedup");
+    for(int f = 0; f < NFUNCS; f++){
+        batch_fn fn[3] = {funcs[f].ref, funcs[f].scalar, funcs[f].simd};
+        double rate[3];
+
+        for(int v = 0; v < 3; v++){
+            double start;
+
+            fn[v](in, a, n); // warm up
+            start = now();
+            for(int r = 0; r < reps; r++){
+                fn[v](in, a, n);
+            }
+            rate[v] = (double)n * reps / (now() - start) / 1e6;
+        }
+        printf("%-12s %14.0f %14.0f %14.0f %8.1fx\n", funcs[f].name, rate[0], rate[1], rate[2],
+               rate[2] / rate[0]);
+    }
+    return 0;
+}
@@ -0,0 +1,1350 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * cachesim.c - cache simulator library behind csim (see cachesim.h)
+ */
+
+#include "cachesim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__AVX2__) || defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+/*
+ * cache structure decription
+ *
+ * Each core's cache is a single allocation in struct-of-arrays layout:
+ * every tag of every set first, then every age, then the line states,
+ * then the prefetched flags.
+ * A set occupies `stride` consecutive slots (E rounded up to the SIMD
+ * width) so the tag compare in hit_miss can load all ways of a set at
+ * once. The valid bit is folded into the top bit of the stored tag,
+ * which is never set by a real tag since tag = address >> (s+b).
+ * Padding slots stay zero, so they can never match.
+ */
+#define VALID_BIT (1ULL << 63)
+#define WAY_ALIGN 4 // ways per 256-bit vector
+
+/*line states (MESI, plus OWNED for MOESI); a single core only uses I/E/M*/
+#define INVALID 0
+#define SHARED 1
+#define EXCLUSIVE 2
+#define OWNED 3
+#define MODIFIED 4
+
+#define TOP_LINES 10 // default number of lines listed in a report
+#define HEATMAP_SETS 64 // sets printed one by one before only the hottest are
+
+#define STRIDE_ENTRIES 16 // streams tracked per core
+#define STRIDE_WINDOW 256 // blocks a stream may jump and still be the same stream
+#define STREAM_BUFFERS 4
+
+typedef struct{
+    unsigned long long int *tag; // tag[set_index * stride + way] | VALID_BIT
+    unsigned long long int *age; // LRU time stamp, 0 for invalid lines
+    unsigned char *state;        // INVALID ... MODIFIED
+    unsigned char *prefetched;   // filled by a prefetch and not demanded yet
+    int stride;                  // slots per set
+    int ways;                    // E, or the associativity of a TLB level
+    unsigned long long int hits, misses, evictions; // per-core share of the totals
+    unsigned long long int coherence_misses;
+    unsigned long long int invalidations;           // copies of this core invalidated by others
+} caches;
+
+/*per-line record: sharing in multi-core mode, prefetch victims, misses with report*/
+typedef struct{
+    unsigned long long int block; // block address + 1, 0 marks an empty slot
+    int invalidations;
+    int coherence_misses;
+    unsigned int writers;                  // cores that stored to the line
+    unsigned int invalidated;              // cores whose copy was invalidated since they last had it
+    bool prefetch_victim;                  // last evicted to make room for a prefetch
+    bool seen;                             // referenced before (not compulsory)
+    int misses;
+    int evictions;
+    int shadow;                            // node + 1 in the shadow cache, 0 if absent
+    unsigned long long int bytes[CSIM_MAXCORES]; // line offsets each core touched, 64 chunks
+} line_stat;
+
+/*stride prefetcher stream, matched by address instead of by PC*/
+typedef struct{
+    unsigned long long int last; // last block of the stream
+    long long int stride;        // in blocks
+    int confidence;              // times in a row the stride repeated
+    unsigned long long int age;
+} stride_entry;
+
+/*stream buffer: FIFO of the blocks head .. head + count - 1*/
+typedef struct{
+    unsigned long long int head;
+    int count;
+    unsigned long long int age;
+} stream_buffer;
+
+/*
+ * fully-associative LRU cache with the same number of lines, kept
+ * beside core 0 to split its misses into capacity and conflict misses.
+ * Nodes form a doubly linked list from most (head) to least (tail)
+ * recently used.
+ */
+typedef struct{
+    unsigned long long int *block; // block held by each node
+    int *prev;
+    int *next;
+    int head, tail;                // -1 when empty
+    int used, cap;
+} shadow_cache;
+
+/*
+ * page table: virtual page -> physical frame, filled on first touch.
+ * Frames are handed out in first-touch order. Open addressing keyed by
+ * vpn + 1, doubled when half full.
+ */
+typedef struct{
+    unsigned long long int vpn;  // vpn + 1, 0 marks an empty slot
+    unsigned long long int pfn;
+} pte;
+
+/*per-set totals, sorted for the heatmap*/
+typedef struct{
+    int set;
+    int misses;
+    int evictions;
+} set_stat;
+
+struct cache_sim{
+    csim_config cfg;             // degree resolved, otherwise as given
+    int s, E, b;
+    caches cache[CSIM_MAXCORES];
+    csim_stats count;            // dirty_lines is filled in by csim_snapshot
+    unsigned long long int LRU;
+
+    line_stat *lines;
+    size_t line_cap;
+    size_t line_used;
+
+    stride_entry stride_table[CSIM_MAXCORES][STRIDE_ENTRIES];
+    stream_buffer streams[STREAM_BUFFERS];
+
+    /*TLB: L1 dTLB and STLB per core, disabled while page_shift is 0*/
+    int walk_levels;             // page-table levels read by one walk
+    int dtlb_set_bits, stlb_set_bits;
+    caches dtlb[CSIM_MAXCORES];
+    caches stlb[CSIM_MAXCORES];
+    pte *page_table;
+    size_t pt_cap;
+
+    int *set_misses;
+    int *set_evictions;
+    shadow_cache shadow;
+
+    bool failed;                 // a table could not grow: counters are no longer exact
+    line_stat spare;             // stands in for a record stat_of could not make room for
+};
+
+static line_stat *stat_of(cache_sim *sim, unsigned long long int block);
+static line_stat *find_stat(cache_sim *sim, unsigned long long int block);
+static int eviction(cache_sim *sim, caches *c, unsigned long long int tag, unsigned long long int set_index);
+
+void csim_default_config(csim_config *cfg){
+
+    memset(cfg, 0, sizeof(*cfg));
+    cfg->write_back = true;
+    cfg->write_allocate = true;
+    cfg->ncores = 1;
+    cfg->prefetcher = CSIM_PF_NONE;
+    cfg->top_n = TOP_LINES;
+    cfg->dtlb_entries = 64;
+    cfg->dtlb_ways = 4;
+    cfg->stlb_entries = 1536;
+    cfg->stlb_ways = 12;
+}
+
+/*
+ * set_bits_of - log2 of entries / ways, or -1 if that is not a power of two
+ */
+static int set_bits_of(int entries, int ways){
+
+    int sets;
+
+    if(entries <= 0 || ways <= 0 || entries % ways){
+        return -1;
+    }
+    sets = entries / ways;
+    return (sets & (sets - 1)) ? -1 : __builtin_ctz(sets);
+}
+
+const char *csim_check_config(const csim_config *cfg){
+
+    if(cfg->s < 0 || cfg->E <= 0 || cfg->b < 0 || cfg->s + cfg->b >= 63){
+        return "bad cache geometry";
+    }
+    if(cfg->ncores < 1 || cfg->ncores > CSIM_MAXCORES){
+        return "bad number of cores";
+    }
+    if(cfg->ncores > 1 && (!cfg->write_back || !cfg->write_allocate)){
+        return "multi-core mode needs -w wb -a wa";
+    }
+    if(cfg->ncores > 1 && cfg->prefetcher == CSIM_PF_STREAM){
+        return "stream buffers are not kept coherent, use them with one core";
+    }
+    if(cfg->prefetcher < CSIM_PF_NONE || cfg->prefetcher > CSIM_PF_STREAM || cfg->degree < 0 || cfg->top_n < 0){
+        return "bad prefetcher or report setting";
+    }
+    if(cfg->page_shift && (cfg->page_shift < cfg->b || cfg->page_shift >= 63 ||
+                           set_bits_of(cfg->dtlb_entries, cfg->dtlb_ways) < 0 ||
+                           set_bits_of(cfg->stlb_entries, cfg->stlb_ways) < 0)){
+        return "TLB levels need entries = ways * 2^k, and blocks no larger than a page";
+    }
+    return NULL;
+}
+
+/*
+ * cache_init - allocate 2^set_bits sets of `ways` lines: tags, ages,
+ *     states and flags in one aligned, zeroed block
+ */
+static int cache_init(caches *c, int set_bits, int ways){
+
+    size_t slots, bytes;
+
+    c->ways = ways;
+    c->stride = (ways + WAY_ALIGN - 1) & ~(WAY_ALIGN - 1);
+    slots = (size_t)c->stride << set_bits;
+    bytes = ((sizeof(unsigned long long int) + 1) * slots * 2 + 31) & ~(size_t)31; // aligned_alloc wants a multiple of 32
+
+    c->tag = aligned_alloc(32, bytes);
+    if(c->tag == NULL){
+        return -1;
+    }
+    c->age = c->tag + slots;
+    c->state = (unsigned char *)(c->age + slots);
+    c->prefetched = c->state + slots;
+
+    memset(c->tag, 0, bytes);
+    return 0;
+}
+
+cache_sim *csim_create(const csim_config *cfg){
+
+    cache_sim *sim;
+
+    if(csim_check_config(cfg) != NULL){
+        return NULL;
+    }
+    sim = calloc(1, sizeof(cache_sim));
+    if(sim == NULL){
+        return NULL;
+    }
+
+    sim->cfg = *cfg;
+    sim->s = cfg->s;
+    sim->E = cfg->E;
+    sim->b = cfg->b;
+    if(sim->cfg.degree == 0){
+        sim->cfg.degree = cfg->prefetcher == CSIM_PF_STREAM ? 4 : 1;
+    }
+
+    /*cache memory allocation: one block per core, plus its TLB levels*/
+    if(cfg->page_shift){
+        sim->walk_levels = cfg->page_shift >= 30 ? 2 : cfg->page_shift >= 21 ? 3 : 4;
+        sim->dtlb_set_bits = set_bits_of(cfg->dtlb_entries, cfg->dtlb_ways);
+        sim->stlb_set_bits = set_bits_of(cfg->stlb_entries, cfg->stlb_ways);
+    }
+    for(int k = 0; k < cfg->ncores; k++){
+        if(cache_init(&sim->cache[k], sim->s, sim->E) != 0 ||
+           (cfg->page_shift && (cache_init(&sim->dtlb[k], sim->dtlb_set_bits, cfg->dtlb_ways) != 0 ||
+                                cache_init(&sim->stlb[k], sim->stlb_set_bits, cfg->stlb_ways) != 0))){
+            csim_free(sim);
+            return NULL;
+        }
+    }
+
+    /*miss attribution: per-set counters and the shadow cache*/
+    if(cfg->report){
+        shadow_cache *sh = &sim->shadow;
+
+        sim->set_misses = calloc((size_t)1 << sim->s, sizeof(int));
+        sim->set_evictions = calloc((size_t)1 << sim->s, sizeof(int));
+        sh->cap = sim->E << sim->s;
+        sh->block = malloc(sizeof(unsigned long long int) * sh->cap);
+        sh->prev = malloc(sizeof(int) * sh->cap);
+        sh->next = malloc(sizeof(int) * sh->cap);
+        sh->head = sh->tail = -1;
+        if(sim->set_misses == NULL || sim->set_evictions == NULL || sh->block == NULL ||
+           sh->prev == NULL || sh->next == NULL){
+            csim_free(sim);
+            return NULL;
+        }
+    }
+
+    return sim;
+}
+
+void csim_free(cache_sim *sim){
+
+    if(sim == NULL){
+        return;
+    }
+    for(int k = 0; k < sim->cfg.ncores; k++){ // ages, states and flags share the block
+        free(sim->cache[k].tag);
+        free(sim->dtlb[k].tag);
+        free(sim->stlb[k].tag);
+    }
+    free(sim->page_table);
+    free(sim->lines);
+    free(sim->set_misses);
+    free(sim->set_evictions);
+    free(sim->shadow.block);
+    free(sim->shadow.prev);
+    free(sim->shadow.next);
+    free(sim);
+}
+
+void csim_snapshot(const cache_sim *sim, csim_stats *out){
+
+    *out = sim->count;
+    out->dirty_lines = 0;
+    for(int k = 0; k < sim->cfg.ncores; k++){ // lines that still owe a write-back
+        const caches *c = &sim->cache[k];
+        size_t slots = (size_t)c->stride << sim->s;
+
+        for(size_t i = 0; i < slots; i++){
+            out->dirty_lines += c->state[i] == MODIFIED || c->state[i] == OWNED;
+        }
+    }
+}
+
+
+/*
+ * find_way - index of the valid way in the set holding `probe`
+ *     (a tag with VALID_BIT set), or -1. All ways are compared at once:
+ *     four per step with AVX2, two with SSE4.1, one otherwise.
+ */
+static inline int find_way(const unsigned long long int *ways, int stride, unsigned long long int probe){
+
+#if defined(__AVX2__)
+    __m256i key = _mm256_set1_epi64x((long long)probe);
+    for(int i=0;i<stride;i+=4){
+        __m256i v = _mm256_load_si256((const __m256i *)(ways + i));
+        int mask = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpeq_epi64(v, key)));
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+#elif defined(__SSE4_1__)
+    __m128i key = _mm_set1_epi64x((long long)probe);
+    for(int i=0;i<stride;i+=2){
+        __m128i v = _mm_load_si128((const __m128i *)(ways + i));
+        int mask = _mm_movemask_pd(_mm_castsi128_pd(_mm_cmpeq_epi64(v, key)));
+        if(mask){
+            return i + __builtin_ctz(mask);
+        }
+    }
+#else
+    for(int i=0;i<stride;i++){ // padding slots never match
+        if(ways[i] == probe){
+            return i;
+        }
+    }
+#endif
+    return -1;
+}
+
+/*
+ * victim_way - the LRU way of a set, i.e. the one eviction will replace
+ */
+static int victim_way(caches *c, unsigned long long int set_index){
+
+    unsigned long long int *age = c->age + set_index * c->stride;
+    int change = 0;
+
+    for(int i=1;i<c->ways;i++){ // oldest block finding, invalid lines have age 0
+        if(age[i] < age[change]){
+            change = i;
+        }
+    }
+    return change;
+}
+
+/*
+ * snoop - broadcast a bus transaction from `core` to every other cache.
+ *     A read (BusRd) demotes other copies to SHARED; a dirty copy is
+ *     flushed to memory under MESI and kept as OWNED under MOESI. A
+ *     read-for-ownership (BusRdX / BusUpgr) invalidates other copies.
+ *     Sets *shared if another copy exists and returns true if another
+ *     cache supplied the data.
+ */
+static bool snoop(cache_sim *sim, int core, unsigned long long int block, bool exclusive, bool *shared){
+
+    unsigned long long int tag = block >> sim->s;
+    unsigned long long int set_index = block & ((1ULL<<sim->s) - 1);
+    bool supplied = false;
+
+    *shared = false;
+
+    for(int k = 0; k < sim->cfg.ncores; k++){
+
+        caches *c = &sim->cache[k];
+        size_t base = set_index * c->stride;
+        int way;
+        size_t slot;
+        unsigned char st;
+
+        if(k == core){
+            continue;
+        }
+        way = find_way(c->tag + base, c->stride, tag | VALID_BIT);
+        if(way == -1){
+            continue;
+        }
+        slot = base + way;
+        st = c->state[slot];
+        *shared = true;
+
+        if(st == MODIFIED || st == OWNED){
+            supplied = true;
+            if(!sim->cfg.moesi){ // MESI has no owner, memory is updated on the flush
+                sim->count.writeback_bytes += 1ULL << sim->b;
+                sim->count.mem_write_bytes += 1ULL << sim->b;
+            }
+        }
+
+        if(exclusive){
+            line_stat *stat = stat_of(sim, block);
+
+            c->tag[slot] = 0;
+            c->age[slot] = 0;
+            c->state[slot] = INVALID;
+            if(c->prefetched[slot]){
+                c->prefetched[slot] = 0;
+                sim->count.useless++;
+            }
+            c->invalidations++;
+            sim->count.invalidations++;
+            stat->invalidations++;
+            stat->invalidated |= 1u << k;
+        }
+        else if(st == MODIFIED && sim->cfg.moesi){
+            c->state[slot] = OWNED;
+        }
+        else if(st != OWNED){
+            c->state[slot] = SHARED;
+        }
+    }
+
+    if(sim->cfg.display == true && exclusive && *shared){
+        printf("invalidate ");
+    }
+    if(supplied){
+        sim->count.transfers++;
+    }
+    return supplied;
+}
+
+/*
+ * fill - bring a missing block into `core`, fetching it from another
+ *     cache or from memory; returns the slot it was placed in
+ */
+static size_t fill(cache_sim *sim, int core, unsigned long long int block, bool exclusive){
+
+    caches *c = &sim->cache[core];
+    unsigned long long int tag = block >> sim->s;
+    unsigned long long int set_index = block & ((1ULL<<sim->s) - 1);
+    bool shared;
+    int way;
+
+    if(sim->cfg.ncores > 1){ // a miss on a line another core took away is a coherence miss
+        line_stat *stat = stat_of(sim, block);
+
+        if(stat->invalidated & (1u << core)){
+            stat->invalidated &= ~(1u << core);
+            stat->coherence_misses++;
+            c->coherence_misses++;
+            sim->count.coherence_misses++;
+            if(sim->cfg.display == true){
+                printf("coherence ");
+            }
+        }
+    }
+
+    if(sim->cfg.prefetcher != CSIM_PF_NONE){ // the line was pushed out to make room for a prefetch
+        line_stat *stat = find_stat(sim, block);
+
+        if(stat != NULL && stat->prefetch_victim){
+            stat->prefetch_victim = false;
+            sim->count.polluting++;
+        }
+    }
+    sim->count.demand_fills++;
+
+    if(!snoop(sim, core, block, exclusive, &shared)){
+        sim->count.mem_read_bytes += 1ULL << sim->b;
+    }
+
+    way = eviction(sim, c, tag, set_index);
+    c->state[set_index * c->stride + way] = exclusive ? MODIFIED : (shared ? SHARED : EXCLUSIVE);
+
+    return set_index * c->stride + way;
+}
+
+/*
+ * first_use - true the first time a prefetched line is demanded
+ */
+static bool first_use(cache_sim *sim, caches *c, size_t slot){
+
+    if(!c->prefetched[slot]){
+        return false;
+    }
+    c->prefetched[slot] = 0;
+    sim->count.useful++;
+    return true;
+}
+
+/*
+ * hit_miss - look the tag up in its set; returns the hit way or -1
+ */
+static int hit_miss(cache_sim *sim, caches *c, unsigned long long int tag, unsigned long long int set_index){
+
+    size_t base = set_index * c->stride;
+    int way = find_way(c->tag + base, c->stride, tag | VALID_BIT);
+
+    sim->LRU++;
+
+    /*hit process*/
+    if(way >= 0){
+
+        sim->count.hits++;
+        c->hits++;
+        if(sim->cfg.display == true){
+            printf("hit ");
+        }
+
+        c->age[base + way] = sim->LRU;
+
+        return way; //if hit, quit function
+    }
+
+    /*miss process*/
+    sim->count.misses++;
+    c->misses++;
+
+    if(sim->cfg.display == true){
+        printf("miss ");
+    }
+
+    return -1;
+}
+
+/*
+ * eviction - place the tag in the LRU way of its set, writing the old
+ *     line back first if it is dirty; returns the filled way
+ */
+static int eviction(cache_sim *sim, caches *c, unsigned long long int tag, unsigned long long int set_index){
+
+    size_t base = set_index * c->stride;
+    unsigned long long int *age = c->age + base;
+    int change = victim_way(c, set_index);
+
+    if(c->tag[base + change] & VALID_BIT){
+
+        sim->count.evictions++;
+        c->evictions++;
+        if(sim->cfg.display == true){
+            printf("eviction ");
+        }
+
+        if(c->state[base + change] == MODIFIED || c->state[base + change] == OWNED){
+            sim->count.dirty_evictions++;
+            sim->count.writeback_bytes += 1ULL << sim->b;
+            sim->count.mem_write_bytes += 1ULL << sim->b;
+            if(sim->cfg.display == true){
+                printf("writeback ");
+            }
+        }
+
+        if(c->prefetched[base + change]){
+            sim->count.useless++;
+        }
+
+        if(sim->cfg.report){
+            sim->set_evictions[set_index]++;
+            stat_of(sim, ((c->tag[base + change] & ~VALID_BIT) << sim->s) | set_index)->evictions++;
+        }
+
+    }
+
+    /*replacing value*/
+    c->tag[base + change] = tag | VALID_BIT;
+    c->state[base + change] = EXCLUSIVE;
+    c->prefetched[base + change] = 0;
+    age[change] = sim->LRU;
+
+    return change;
+
+}
+
+/*
+ * prefetch_block - bring a block into `core` ahead of demand. Blocks
+ *     already cached are skipped; the line a prefetch evicts is
+ *     remembered so a later demand miss on it counts as pollution.
+ */
+static void prefetch_block(cache_sim *sim, int core, unsigned long long int block){
+
+    caches *c = &sim->cache[core];
+    unsigned long long int tag = block >> sim->s;
+    unsigned long long int set_index = block & ((1ULL<<sim->s) - 1);
+    size_t base = set_index * c->stride;
+    int way = victim_way(c, set_index);
+    bool shared;
+
+    if(find_way(c->tag + base, c->stride, tag | VALID_BIT) >= 0){
+        return;
+    }
+
+    if(c->tag[base + way] & VALID_BIT){
+        stat_of(sim, ((c->tag[base + way] & ~VALID_BIT) << sim->s) | set_index)->prefetch_victim = true;
+    }
+
+    sim->count.prefetches++;
+    if(sim->cfg.display == true){
+        printf("prefetch ");
+    }
+
+    if(!snoop(sim, core, block, false, &shared)){
+        sim->count.mem_read_bytes += 1ULL << sim->b;
+    }
+
+    way = eviction(sim, c, tag, set_index);
+    c->state[base + way] = shared ? SHARED : EXCLUSIVE;
+    c->prefetched[base + way] = 1;
+}
+
+/*
+ * prefetch - train the prefetcher on a demand access to `block` and
+ *     issue whatever it predicts. `trigger` is set for a miss or the
+ *     first use of a prefetched line. Stream buffers act on misses only,
+ *     in stream_fill.
+ */
+static void prefetch(cache_sim *sim, int core, unsigned long long int block, bool trigger){
+
+    stride_entry *table = sim->stride_table[core];
+    stride_entry *e = NULL;
+    unsigned long long int distance = STRIDE_WINDOW + 1;
+    int degree = sim->cfg.degree;
+
+    switch(sim->cfg.prefetcher){
+        case CSIM_PF_NEXT:
+        if(trigger){
+            for(int k = 1; k <= degree; k++){
+                prefetch_block(sim, core, block + k);
+            }
+        }
+        break;
+
+        case CSIM_PF_STRIDE:
+        for(int i = 0; i < STRIDE_ENTRIES; i++){ // closest stream within the window
+            unsigned long long int d = block > table[i].last ? block - table[i].last : table[i].last - block;
+
+            if(table[i].age && d < distance){
+                distance = d;
+                e = &table[i];
+            }
+        }
+
+        if(e == NULL || distance > STRIDE_WINDOW){ // start a new stream in the LRU entry
+            e = &table[0];
+            for(int i = 1; i < STRIDE_ENTRIES; i++){
+                if(table[i].age < e->age){
+                    e = &table[i];
+                }
+            }
+            e->last = block;
+            e->stride = 0;
+            e->confidence = 0;
+            e->age = sim->LRU;
+            break;
+        }
+
+        e->age = sim->LRU;
+        if(distance == 0){ // still inside the same line
+            break;
+        }
+        if((long long int)(block - e->last) == e->stride){
+            if(e->confidence < 3){
+                e->confidence++;
+            }
+        }
+        else{
+            e->stride = (long long int)(block - e->last);
+            e->confidence = 0;
+        }
+        e->last = block;
+
+        if(e->confidence >= 2){
+            for(int k = 1; k <= degree; k++){
+                prefetch_block(sim, core, block + e->stride * k);
+            }
+        }
+        break;
+    }
+}
+
+/*
+ * stream_fill - on a miss, look for the block in the stream buffers. A
+ *     match moves it into the cache without a memory access, drops the
+ *     blocks the stream skipped and tops the buffer up again. Otherwise
+ *     the LRU buffer restarts at the next block. Returns true (and the
+ *     filled slot) if a buffer supplied the block.
+ */
+static bool stream_fill(cache_sim *sim, int core, unsigned long long int block, size_t *slot){
+
+    caches *c = &sim->cache[core];
+    unsigned long long int set_index = block & ((1ULL<<sim->s) - 1);
+    stream_buffer *sb = &sim->streams[0];
+    int degree = sim->cfg.degree;
+
+    if(sim->cfg.prefetcher != CSIM_PF_STREAM){
+        return false;
+    }
+
+    for(int i = 0; i < STREAM_BUFFERS; i++){
+        stream_buffer *q = &sim->streams[i];
+
+        if(q->count > 0 && block >= q->head && block < q->head + q->count){
+
+            int used = (int)(block - q->head) + 1;
+
+            sim->count.useless += used - 1;
+            sim->count.useful++;
+            q->head = block + 1;
+            q->count -= used;
+
+            sim->count.prefetches += degree - q->count; // refill the tail
+            sim->count.mem_read_bytes += (unsigned long long int)(degree - q->count) << sim->b;
+            q->count = degree;
+            q->age = sim->LRU;
+
+            if(sim->cfg.display == true){
+                printf("stream ");
+            }
+            *slot = set_index * c->stride + eviction(sim, c, block >> sim->s, set_index);
+            return true;
+        }
+        if(q->age < sb->age){
+            sb = q;
+        }
+    }
+
+    sim->count.useless += sb->count;
+    sb->head = block + 1;
+    sb->count = degree;
+    sb->age = sim->LRU;
+    sim->count.prefetches += degree;
+    sim->count.mem_read_bytes += (unsigned long long int)degree << sim->b;
+
+    return false;
+}
+
+/*
+ * shadow_access - reference a block in the fully-associative shadow
+ *     cache; returns true on a hit. A miss takes a free node or the LRU
+ *     one.
+ */
+static bool shadow_access(cache_sim *sim, line_stat *st, unsigned long long int block){
+
+    shadow_cache *sh = &sim->shadow;
+    int node = st->shadow - 1;
+
+    if(node >= 0){ // hit: unlink, then move to the front below
+        if(node == sh->head){
+            return true;
+        }
+        sh->next[sh->prev[node]] = sh->next[node];
+        if(sh->next[node] >= 0){
+            sh->prev[sh->next[node]] = sh->prev[node];
+        }
+        else{
+            sh->tail = sh->prev[node];
+        }
+    }
+    else if(sh->used < sh->cap){
+        node = sh->used++;
+    }
+    else{ // reuse the LRU node
+        node = sh->tail;
+        find_stat(sim, sh->block[node])->shadow = 0;
+        sh->tail = sh->prev[node];
+        if(sh->tail >= 0){
+            sh->next[sh->tail] = -1;
+        }
+        else{
+            sh->head = -1;
+        }
+    }
+
+    sh->prev[node] = -1;
+    sh->next[node] = sh->head;
+    if(sh->head >= 0){
+        sh->prev[sh->head] = node;
+    }
+    sh->head = node;
+    if(sh->tail < 0){
+        sh->tail = node;
+    }
+
+    if(st->shadow){
+        return true;
+    }
+    sh->block[node] = block;
+    st->shadow = node + 1;
+    return false;
+}
+
+/*
+ * attribute - charge a demand access to its line and set. With a single
+ *     core the miss is also classified: compulsory on the first reference,
+ *     capacity if the shadow cache misses too, conflict otherwise.
+ */
+static void attribute(cache_sim *sim, int core, unsigned long long int block, bool miss){
+
+    line_stat *st;
+    bool in_shadow;
+
+    if(!sim->cfg.report){
+        return;
+    }
+
+    st = stat_of(sim, block);
+    if(miss){
+        st->misses++;
+        sim->set_misses[block & ((1ULL<<sim->s) - 1)]++;
+    }
+
+    if(sim->cfg.ncores > 1 || core != 0){
+        return;
+    }
+
+    in_shadow = shadow_access(sim, st, block);
+    if(miss){
+        if(!st->seen){
+            sim->count.compulsory++;
+        }
+        else if(!in_shadow){
+            sim->count.capacity++;
+        }
+        else{
+            sim->count.conflict++;
+        }
+    }
+    st->seen = true;
+}
+
+/*
+ * load - read one block; a miss fills the line from a stream buffer,
+ *     another cache or memory
+ */
+static void load(cache_sim *sim, int core, unsigned long long int block){
+
+    caches *c = &sim->cache[core];
+    unsigned long long int set_index = block & ((1ULL<<sim->s) - 1);
+    int way = hit_miss(sim, c, block >> sim->s, set_index);
+    size_t slot;
+
+    attribute(sim, core, block, way == -1);
+    if(way == -1){
+        if(!stream_fill(sim, core, block, &slot)){
+            fill(sim, core, block, false);
+        }
+    }
+    prefetch(sim, core, block, way == -1 || first_use(sim, c, set_index * c->stride + way));
+}
+
+/*
+ * store - write `bytes` bytes of one block under the current policy.
+ *     Write-back marks the line MODIFIED, invalidating other copies
+ *     first, write-through sends the bytes to memory. Without
+ *     write-allocate a store miss bypasses the cache.
+ */
+static void store(cache_sim *sim, int core, unsigned long long int block, int bytes){
+
+    caches *c = &sim->cache[core];
+    unsigned long long int set_index = block & ((1ULL<<sim->s) - 1);
+    int way = hit_miss(sim, c, block >> sim->s, set_index);
+    size_t slot;
+    bool shared;
+
+    attribute(sim, core, block, way == -1);
+    if(way == -1){
+        if(!sim->cfg.write_allocate){
+            sim->count.mem_write_bytes += bytes;
+            return;
+        }
+        if(!stream_fill(sim, core, block, &slot)){
+            slot = fill(sim, core, block, sim->cfg.write_back);
+        }
+    }
+    else{
+        slot = set_index * c->stride + way;
+        if(sim->cfg.write_back && (c->state[slot] == SHARED || c->state[slot] == OWNED)){
+            snoop(sim, core, block, true, &shared); // upgrade, no data moves
+        }
+    }
+
+    if(sim->cfg.write_back){
+        c->state[slot] = MODIFIED;
+    }
+    else{
+        sim->count.mem_write_bytes += bytes;
+    }
+    prefetch(sim, core, block, way == -1 || first_use(sim, c, slot));
+}
+
+/*
+ * tlb_access - look a page up in one TLB level, filling it on a miss;
+ *     returns true on a hit
+ */
+static bool tlb_access(cache_sim *sim, caches *tlb, int set_bits, unsigned long long int vpn){
+
+    unsigned long long int set_index = vpn & ((1ULL<<set_bits) - 1);
+    unsigned long long int tag = vpn >> set_bits;
+    size_t base = set_index * tlb->stride;
+    int way = find_way(tlb->tag + base, tlb->stride, tag | VALID_BIT);
+    bool hit = way >= 0;
+
+    if(!hit){
+        way = victim_way(tlb, set_index);
+        tlb->tag[base + way] = tag | VALID_BIT;
+    }
+    tlb->age[base + way] = sim->LRU;
+    return hit;
+}
+
+/*
+ * frame_of - physical frame of a virtual page, allocating the next free
+ *     frame on first touch
+ */
+static unsigned long long int frame_of(cache_sim *sim, unsigned long long int vpn){
+
+    size_t i;
+
+    if((size_t)sim->count.pages * 2 >= sim->pt_cap){
+        size_t old_cap = sim->pt_cap;
+        pte *old = sim->page_table;
+
+        sim->pt_cap = old_cap ? old_cap * 2 : 1024;
+        sim->page_table = calloc(sim->pt_cap, sizeof(pte));
+        if(sim->page_table == NULL){ // keep the old table, fail the access under way
+            sim->page_table = old;
+            sim->pt_cap = old_cap;
+            sim->failed = true;
+            return vpn;
+        }
+        for(size_t j = 0; j < old_cap; j++){
+            if(old[j].vpn){
+                i = (old[j].vpn * 0x9E3779B97F4A7C15ULL) & (sim->pt_cap - 1);
+                while(sim->page_table[i].vpn){
+                    i = (i + 1) & (sim->pt_cap - 1);
+                }
+                sim->page_table[i] = old[j];
+            }
+        }
+        free(old);
+    }
+
+    i = ((vpn + 1) * 0x9E3779B97F4A7C15ULL) & (sim->pt_cap - 1);
+    while(sim->page_table[i].vpn && sim->page_table[i].vpn != vpn + 1){
+        i = (i + 1) & (sim->pt_cap - 1);
+    }
+    if(!sim->page_table[i].vpn){
+        sim->page_table[i].vpn = vpn + 1;
+        sim->page_table[i].pfn = sim->count.pages++;
+    }
+    return sim->page_table[i].pfn;
+}
+
+/*
+ * translate - virtual to physical address through the core's L1 dTLB
+ *     and STLB. An STLB miss is a page walk of walk_levels reads; the
+ *     walk itself is counted, not sent through the data cache.
+ */
+static unsigned long long int translate(cache_sim *sim, int core, unsigned long long int address){
+
+    int page_shift = sim->cfg.page_shift;
+    unsigned long long int vpn = address >> page_shift;
+
+    if(!tlb_access(sim, &sim->dtlb[core], sim->dtlb_set_bits, vpn)){
+        sim->count.dtlb_misses++;
+        if(sim->cfg.display == true){
+            printf("dtlb-miss ");
+        }
+        if(!tlb_access(sim, &sim->stlb[core], sim->stlb_set_bits, vpn)){
+            sim->count.stlb_misses++;
+            sim->count.walk_refs += sim->walk_levels;
+            if(sim->cfg.display == true){
+                printf("walk ");
+            }
+        }
+    }
+
+    return (frame_of(sim, vpn) << page_shift) | (address & ((1ULL << page_shift) - 1));
+}
+
+int csim_access(cache_sim *sim, int core, char op, unsigned long long int address, int size){
+
+    int b = sim->b;
+    unsigned long long int end, first, last;
+
+    if(sim->failed){
+        return -1;
+    }
+    if(op != 'L' && op != 'S' && op != 'M'){ // instruction loads are not simulated
+        return 0;
+    }
+
+    /*an access touches every block between its first and last byte*/
+    end = address + (size > 0 ? size : 1);
+    first = address >> b;
+    last = (end - 1) >> b;
+
+    for(unsigned long long int vblock = first; vblock <= last; vblock++){
+
+        unsigned long long int lo = vblock << b;
+        unsigned long long int hi = (vblock + 1) << b;
+        unsigned long long int from = address > lo ? address : lo;
+        unsigned long long int to = end < hi ? end : hi;
+        int bytes = (int)(to - from);
+        unsigned long long int block = vblock; // physical once translated
+
+        if(sim->cfg.page_shift){
+            block = translate(sim, core, lo) >> b;
+        }
+
+        if(sim->cfg.ncores > 1){ // remember who touched which part of the line
+            line_stat *st = stat_of(sim, block);
+            int shift = b > 6 ? b - 6 : 0;
+            int lo_chunk = (int)((from - lo) >> shift);
+            int hi_chunk = (int)((to - 1 - lo) >> shift);
+
+            st->bytes[core] |= (~0ULL >> (63 - hi_chunk)) & (~0ULL << lo_chunk);
+            if(op != 'L'){
+                st->writers |= 1u << core;
+            }
+        }
+
+        switch(op){
+            case 'L':
+            load(sim, core, block);
+            break;
+
+            case 'S':
+            store(sim, core, block, bytes);
+            break;
+
+            case 'M':
+            load(sim, core, block);
+            store(sim, core, block, bytes);
+            break;
+        }
+    }
+    return sim->failed ? -1 : 0;
+}
+
+int csim_access_batch(cache_sim *sim, const unsigned long long int *addrs, const char *ops,
+                      const int *sizes, int size, size_t n){
+
+    int b = sim->b;
+    int bytes = size > 0 ? size : 1;
+
+    if(sizes != NULL || sim->cfg.page_shift || sim->cfg.ncores > 1){
+        for(size_t i = 0; i < n; i++){
+            if(csim_access(sim, 0, ops[i], addrs[i], sizes != NULL ? sizes[i] : size) != 0){
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    /*no translation, one size: skip the per-record setup unless an access straddles blocks*/
+    for(size_t i = 0; i < n && !sim->failed; i++){
+        unsigned long long int block = addrs[i] >> b;
+
+        if((addrs[i] & ((1ULL << b) - 1)) + bytes > (1ULL << b)){
+            csim_access(sim, 0, ops[i], addrs[i], size);
+            continue;
+        }
+        switch(ops[i]){
+            case 'L':
+            load(sim, 0, block);
+            break;
+
+            case 'S':
+            store(sim, 0, block, bytes);
+            break;
+
+            case 'M':
+            load(sim, 0, block);
+            store(sim, 0, block, bytes);
+            break;
+        }
+    }
+    return sim->failed ? -1 : 0;
+}
+
+/*
+ * find_stat - record of a block, or NULL if it has none yet
+ */
+static line_stat *find_stat(cache_sim *sim, unsigned long long int block){
+
+    size_t i;
+
+    if(sim->line_cap == 0){
+        return NULL;
+    }
+    i = ((block + 1) * 0x9E3779B97F4A7C15ULL) & (sim->line_cap - 1);
+    while(sim->lines[i].block){
+        if(sim->lines[i].block == block + 1){
+            return &sim->lines[i];
+        }
+        i = (i + 1) & (sim->line_cap - 1);
+    }
+    return NULL;
+}
+
+/*
+ * stat_of - record of a block, created on first use. Open addressing
+ *     with linear probing, doubled when half full.
+ */
+static line_stat *stat_of(cache_sim *sim, unsigned long long int block){
+
+    size_t i;
+
+    if(sim->line_used * 2 >= sim->line_cap){
+        size_t old_cap = sim->line_cap;
+        line_stat *old = sim->lines;
+
+        sim->line_cap = old_cap ? old_cap * 2 : 1024;
+        sim->lines = calloc(sim->line_cap, sizeof(line_stat));
+        if(sim->lines == NULL){ // keep the old table, fail the access under way
+            sim->lines = old;
+            sim->line_cap = old_cap;
+            sim->failed = true;
+            memset(&sim->spare, 0, sizeof(line_stat));
+            return &sim->spare;
+        }
+        for(size_t j = 0; j < old_cap; j++){
+            if(old[j].block){
+                i = (old[j].block * 0x9E3779B97F4A7C15ULL) & (sim->line_cap - 1);
+                while(sim->lines[i].block){
+                    i = (i + 1) & (sim->line_cap - 1);
+                }
+                sim->lines[i] = old[j];
+            }
+        }
+        free(old);
+    }
+
+    i = ((block + 1) * 0x9E3779B97F4A7C15ULL) & (sim->line_cap - 1);
+    while(sim->lines[i].block && sim->lines[i].block != block + 1){
+        i = (i + 1) & (sim->line_cap - 1);
+    }
+    if(!sim->lines[i].block){
+        sim->lines[i].block = block + 1;
+        sim->line_used++;
+    }
+    return &sim->lines[i];
+}
+
+/*
+ * true_sharing - true if some core wrote a part of the line another core
+ *     also touched; otherwise the contention on it is false sharing
+ */
+static bool true_sharing(const cache_sim *sim, const line_stat *st){
+
+    for(int i = 0; i < sim->cfg.ncores; i++){
+        if(!(st->writers & (1u << i))){
+            continue;
+        }
+        for(int j = 0; j < sim->cfg.ncores; j++){
+            if(j != i && (st->bytes[i] & st->bytes[j])){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static int by_contention(const void *x, const void *y){
+
+    const line_stat *p = *(const line_stat *const *)x;
+    const line_stat *q = *(const line_stat *const *)y;
+
+    return (q->invalidations + q->coherence_misses) - (p->invalidations + p->coherence_misses);
+}
+
+/*
+ * print_coherence - per-core counts and the most contended lines
+ */
+static void print_coherence(const cache_sim *sim){
+
+    line_stat **hot = malloc(sizeof(line_stat *) * (sim->line_used + 1));
+    size_t n = 0;
+
+    printf("invalidations:%llu coherence_misses:%llu transfers:%llu\n",
+           sim->count.invalidations, sim->count.coherence_misses, sim->count.transfers);
+    for(int k = 0; k < sim->cfg.ncores; k++){
+        const caches *c = &sim->cache[k];
+
+        printf("core %d: hits:%llu misses:%llu evictions:%llu coherence_misses:%llu invalidated:%llu\n", k,
+               c->hits, c->misses, c->evictions, c->coherence_misses, c->invalidations);
+    }
+
+    if(hot == NULL){
+        return;
+    }
+    for(size_t i = 0; i < sim->line_cap; i++){
+        if(sim->lines[i].block && sim->lines[i].invalidations + sim->lines[i].coherence_misses > 0){
+            hot[n++] = &sim->lines[i];
+        }
+    }
+    qsort(hot, n, sizeof(line_stat *), by_contention);
+
+    if(n > 0){
+        printf("contended lines:\n");
+    }
+    for(size_t i = 0; i < n && i < (size_t)sim->cfg.top_n; i++){
+        unsigned int touched = 0;
+
+        for(int k = 0; k < sim->cfg.ncores; k++){
+            if(hot[i]->bytes[k]){
+                touched |= 1u << k;
+            }
+        }
+        printf("  %llx invalidations:%d coherence_misses:%d cores:%x writers:%x %s sharing\n",
+               (hot[i]->block - 1) << sim->b, hot[i]->invalidations, hot[i]->coherence_misses,
+               touched, hot[i]->writers, true_sharing(sim, hot[i]) ? "true" : "false");
+    }
+    free(hot);
+}
+
+/*
+ * print_prefetch - how many prefetches were used, and how many misses
+ *     they removed (coverage) or caused (polluting)
+ */
+static void print_prefetch(const cache_sim *sim){
+
+    const csim_stats *n = &sim->count;
+    double accuracy = n->prefetches ? (double)n->useful / n->prefetches : 0;
+    double coverage = n->useful + n->demand_fills ? (double)n->useful / (n->useful + n->demand_fills) : 0;
+
+    printf("prefetches:%llu useful:%llu useless:%llu polluting:%llu accuracy:%.3f coverage:%.3f\n",
+           n->prefetches, n->useful, n->useless, n->polluting, accuracy, coverage);
+}
+
+static int by_misses(const void *x, const void *y){
+
+    const line_stat *p = *(const line_stat *const *)x;
+    const line_stat *q = *(const line_stat *const *)y;
+
+    return q->misses - p->misses;
+}
+
+static int by_set_misses(const void *x, const void *y){
+
+    const set_stat *p = x;
+    const set_stat *q = y;
+
+    return (q->misses + q->evictions) - (p->misses + p->evictions);
+}
+
+/*
+ * print_attribution - 3C split, the lines that miss most, and misses and
+ *     evictions per set. Caches with more than HEATMAP_SETS sets only
+ *     list the top_n hottest sets.
+ */
+static void print_attribution(const cache_sim *sim){
+
+    int sets = 1 << sim->s;
+    int top_n = sim->cfg.top_n;
+    int peak = 1;
+    set_stat *order = malloc(sizeof(set_stat) * sets);
+    line_stat **hot = malloc(sizeof(line_stat *) * (sim->line_used + 1));
+    size_t n = 0;
+
+    if(sim->cfg.ncores == 1){
+        printf("compulsory:%llu capacity:%llu conflict:%llu\n",
+               sim->count.compulsory, sim->count.capacity, sim->count.conflict);
+    }
+
+    if(order == NULL || hot == NULL){
+        free(order);
+        free(hot);
+        return;
+    }
+
+    for(size_t i = 0; i < sim->line_cap; i++){
+        if(sim->lines[i].block && sim->lines[i].misses > 0){
+            hot[n++] = &sim->lines[i];
+        }
+    }
+    qsort(hot, n, sizeof(line_stat *), by_misses);
+
+    printf("top missing lines:\n");
+    for(size_t i = 0; i < n && i < (size_t)top_n; i++){
+        unsigned long long int block = hot[i]->block - 1;
+
+        printf("  %llx set:%llu misses:%d evictions:%d\n", block << sim->b,
+               block & ((1ULL<<sim->s) - 1), hot[i]->misses, hot[i]->evictions);
+    }
+
+    for(int i = 0; i < sets; i++){
+        order[i].set = i;
+        order[i].misses = sim->set_misses[i];
+        order[i].evictions = sim->set_evictions[i];
+        if(order[i].misses + order[i].evictions > peak){
+            peak = order[i].misses + order[i].evictions;
+        }
+    }
+    if(sets > HEATMAP_SETS){
+        qsort(order, sets, sizeof(set_stat), by_set_misses);
+        sets = top_n < sets ? top_n : sets;
+        printf("hottest sets:\n");
+    }
+    else{
+        printf("per-set misses/evictions:\n");
+    }
+    for(int i = 0; i < sets; i++){
+        int width = (int)(40LL * (order[i].misses + order[i].evictions) / peak);
+
+        printf("  set %4d misses:%7d evictions:%7d |", order[i].set, order[i].misses, order[i].evictions);
+        for(int j = 0; j < width; j++){
+            putchar('#');
+        }
+        putchar('\n');
+    }
+
+    free(order);
+    free(hot);
+}
+
+void csim_print_report(const cache_sim *sim){
+
+    csim_stats st;
+
+    csim_snapshot(sim, &st);
+    printf("dirty_evictions:%llu writeback_bytes:%llu dirty_at_exit:%llu mem_read_bytes:%llu mem_write_bytes:%llu\n",
+           st.dirty_evictions, st.writeback_bytes, st.dirty_lines, st.mem_read_bytes, st.mem_write_bytes);
+    if(sim->cfg.ncores > 1){
+        print_coherence(sim);
+    }
+    if(sim->cfg.prefetcher != CSIM_PF_NONE){
+        print_prefetch(sim);
+    }
+    if(sim->cfg.page_shift){
+        printf("dtlb_misses:%llu stlb_misses:%llu page_walks:%llu walk_refs:%llu pages:%llu\n",
+               st.dtlb_misses, st.stlb_misses, st.stlb_misses, st.walk_refs, st.pages);
+    }
+    if(sim->cfg.report){
+        print_attribution(sim);
+    }
+}
@@ -0,0 +1,116 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * cachesim.h - cache simulator library behind csim
+ *
+ * A cache_sim is one independent simulated memory system: 1..CSIM_MAXCORES
+ * private caches (optionally coherent), a prefetcher, TLBs and the miss
+ * attribution tables. Any number of them can live in one process; they
+ * share no state.
+ *
+ *     csim_config cfg;
+ *     cache_sim *sim;
+ *     csim_stats st;
+ *
+ *     csim_default_config(&cfg);
+ *     cfg.s = 5; cfg.E = 1; cfg.b = 5;
+ *     sim = csim_create(&cfg);
+ *     if(csim_access_batch(sim, addrs, ops, NULL, 4, n) != 0)
+ *         ... out of memory ...
+ *     csim_snapshot(sim, &st);
+ *     csim_free(sim);
+ */
+#ifndef CACHESIM_H
+#define CACHESIM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CSIM_MAXCORES 16
+
+/*prefetchers*/
+#define CSIM_PF_NONE 0
+#define CSIM_PF_NEXT 1   // tagged next-line: on a miss or first use of a prefetched line
+#define CSIM_PF_STRIDE 2 // constant stride between successive blocks of a stream
+#define CSIM_PF_STREAM 3 // Jouppi stream buffers beside the cache
+
+typedef struct{
+    int s, E, b;            // 2^s sets of E lines of 2^b bytes
+    bool write_back;        // false: write-through
+    bool write_allocate;    // false: store misses bypass the cache
+    int ncores;             // private caches, 1 .. CSIM_MAXCORES
+    bool moesi;             // false: MESI between the cores
+    int prefetcher;         // CSIM_PF_*
+    int degree;             // blocks prefetched ahead (stream depth), 0 = default
+    bool report;            // keep per-line / per-set miss attribution
+    int top_n;              // lines and sets listed by csim_print_report
+    int page_shift;         // 12, 21 or 30 to translate through TLBs, 0 = off
+    int dtlb_entries, dtlb_ways;
+    int stlb_entries, stlb_ways;
+    bool display;           // print hit/miss/eviction... per access (csim -v)
+} csim_config;
+
+/*counter snapshot, all totals since csim_create*/
+typedef struct{
+    unsigned long long int hits, misses, evictions;
+    unsigned long long int dirty_evictions;
+    unsigned long long int writeback_bytes;  // dirty lines written back on eviction or snoop
+    unsigned long long int dirty_lines;      // lines that still owe a write-back
+    unsigned long long int mem_read_bytes;   // line fills (and prefetches) from memory
+    unsigned long long int mem_write_bytes;  // write-backs plus stores sent straight to memory
+    unsigned long long int invalidations;    // copies invalidated in other cores
+    unsigned long long int coherence_misses; // misses on a line another core invalidated
+    unsigned long long int transfers;        // fills supplied cache-to-cache
+    unsigned long long int prefetches;       // blocks prefetched
+    unsigned long long int useful;           // prefetched blocks demanded before leaving
+    unsigned long long int useless;          // prefetched blocks evicted or dropped unused
+    unsigned long long int polluting;        // demand misses on lines a prefetch evicted
+    unsigned long long int demand_fills;     // demand misses that had to fetch the line
+    unsigned long long int dtlb_misses;
+    unsigned long long int stlb_misses;      // each one a page walk
+    unsigned long long int walk_refs;        // page-table reads done by the walks
+    unsigned long long int pages;            // pages touched
+    unsigned long long int compulsory;       // 3C split (single core, report on)
+    unsigned long long int capacity;
+    unsigned long long int conflict;
+} csim_stats;
+
+typedef struct cache_sim cache_sim;
+
+/* csim_default_config - one write-back, write-allocate cache with
+ *     nothing else turned on. Geometry is left at zero. This matches
+ *     csim-ref except on accesses that straddle two blocks: these are
+ *     looked up in both, where csim-ref only looks at the first, so
+ *     counts differ on unaligned traces. */
+void csim_default_config(csim_config *cfg);
+
+/* csim_check_config - NULL if the configuration is usable, otherwise
+ *     a message saying what is wrong with it */
+const char *csim_check_config(const csim_config *cfg);
+
+/* csim_create - build a simulator; NULL if the configuration is invalid
+ *     or memory runs out */
+cache_sim *csim_create(const csim_config *cfg);
+void csim_free(cache_sim *sim);
+
+/* csim_access - one trace record: op is 'L', 'S' or 'M' ('I' is ignored),
+ *     `size` bytes at `address`, issued by `core`. Returns 0, or -1 once
+ *     the simulator has run out of memory for its line or page tables:
+ *     the counters are then no longer exact and every later access is
+ *     refused with -1 as well. The library never prints or exits on it. */
+int csim_access(cache_sim *sim, int core, char op, unsigned long long int address, int size);
+
+/* csim_access_batch - n accesses from core 0, access i being sizes[i]
+ *     bytes, or `size` bytes for every access when sizes is NULL (store
+ *     sizes are what write-through and no-write-allocate charge to
+ *     mem_write_bytes). Returns 0, or -1 as csim_access does. */
+int csim_access_batch(cache_sim *sim, const unsigned long long int *addrs, const char *ops,
+                      const int *sizes, int size, size_t n);
+
+/* csim_snapshot - copy the current counters */
+void csim_snapshot(const cache_sim *sim, csim_stats *out);
+
+/* csim_print_report - the sections csim prints after printSummary:
+ *     traffic, and coherence / prefetch / TLB / attribution when enabled */
+void csim_print_report(const cache_sim *sim);
+
+#endif
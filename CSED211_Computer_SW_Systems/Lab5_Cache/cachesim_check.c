@@ -0,0 +1,133 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * cachesim_check.c - runs random traces through the cachesim library and
+ *     a plain LRU model written for the check, and compares the hits,
+ *     misses and evictions
+ *
+ * build: gcc -O2 -o cachesim_check cachesim_check.c cachesim.c
+ *        (add -fsanitize=address,undefined to check the allocations too)
+ * usage: ./cachesim_check
+ *
+ * The geometries start at one set of one line (-s 0 -E 1) and include
+ * the lab's -s 1 -E 1 -b 1, where a cache's whole allocation is smaller
+ * than one SIMD stride of slots. Accesses are 1 to 8 bytes at any
+ * offset, so some straddle two blocks and count once for each block.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cachesim.h"
+
+#define ACCESSES 20000
+
+static unsigned long long rng = 0x9E3779B97F4A7C15ull;
+
+static unsigned long long next_random(void){
+
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return rng;
+}
+
+/*the model: stamp[set * E + way] is the last use, 0 for an empty way*/
+static unsigned long long *tags, *stamp, now;
+static unsigned long long hits, misses, evictions;
+
+static void model_access(int s, int E, unsigned long long block){
+
+    unsigned long long set = block & ((1ULL << s) - 1);
+    unsigned long long *t = tags + set * E, *u = stamp + set * E;
+    int victim = 0;
+
+    now++;
+    for(int w = 0; w < E; w++){
+        if(u[w] != 0 && t[w] == block){
+            hits++;
+            u[w] = now;
+            return;
+        }
+        if(u[w] < u[victim]){
+            victim = w;
+        }
+    }
+    misses++;
+    if(u[victim] != 0){
+        evictions++;
+    }
+    t[victim] = block;
+    u[victim] = now;
+}
+
+/*check - one geometry; 0 if the library and the model agree*/
+static int check(int s, int E, int b, unsigned long long span){
+
+    csim_config cfg;
+    csim_stats st;
+    cache_sim *sim;
+
+    csim_default_config(&cfg);
+    cfg.s = s;
+    cfg.E = E;
+    cfg.b = b;
+    if((sim = csim_create(&cfg)) == NULL){
+        printf("-s %d -E %d -b %d: csim_create failed\n", s, E, b);
+        return 1;
+    }
+    tags = calloc((size_t)E << s, sizeof(*tags));
+    stamp = calloc((size_t)E << s, sizeof(*stamp));
+    if(tags == NULL || stamp == NULL){
+        printf("model allocation failed\n");
+        exit(1);
+    }
+    now = hits = misses = evictions = 0;
+
+    for(int i = 0; i < ACCESSES; i++){
+        unsigned long long r = next_random();
+        char op = "LSM"[r % 3];
+        int size = 1 + (int)((r >> 8) % 8);
+        unsigned long long address = (r >> 16) % span;
+
+        if(csim_access(sim, 0, op, address, size) != 0){
+            printf("-s %d -E %d -b %d: csim_access failed\n", s, E, b);
+            return 1;
+        }
+        for(unsigned long long block = address >> b; block <= (address + size - 1) >> b; block++){
+            model_access(s, E, block);
+            if(op == 'M'){
+                model_access(s, E, block);
+            }
+        }
+    }
+    csim_snapshot(sim, &st);
+    csim_free(sim);
+    free(tags);
+    free(stamp);
+
+    printf("-s %2d -E %2d -b %2d  hits:%-6llu misses:%-6llu evictions:%-6llu %s\n", s, E, b, st.hits,
+           st.misses, st.evictions,
+           st.hits == hits && st.misses == misses && st.evictions == evictions ? "ok" : "MISMATCH");
+    if(st.hits != hits || st.misses != misses || st.evictions != evictions){
+        printf("    model hits:%llu misses:%llu evictions:%llu\n", hits, misses, evictions);
+        return 1;
+    }
+    return 0;
+}
+
+int main(void)
+{
+
+    static const int geometry[][3] = {
+        {0, 1, 0}, {0, 1, 4}, {0, 2, 2}, {1, 1, 1}, {1, 2, 1}, {0, 5, 3}, {2, 3, 2},
+        {4, 1, 4}, {5, 1, 5}, {4, 6, 5}, {6, 8, 6}, {8, 16, 6},
+    };
+    int failed = 0;
+
+    for(int g = 0; g < (int)(sizeof(geometry) / sizeof(geometry[0])); g++){
+        int s = geometry[g][0], E = geometry[g][1], b = geometry[g][2];
+
+        // addresses over about four times the cache, so lines get reused and evicted
+        failed += check(s, E, b, 4ULL * E << (s + b));
+    }
+    return failed != 0;
+}
@@ -0,0 +1,242 @@
+/* 20220124 Moonkyeom Kim*/
+
+#include "cachelab.h"
+#include "cachesim.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <getopt.h>
+
+void usage(void);
+
+int main(int argc, char *argv[])
+{
+
+    int opt;
+
+    csim_config cfg;
+    cache_sim *sim;
+    csim_stats st;
+    const char *err;
+    char* t = NULL;
+
+    FILE* trace;
+    char buf[256];
+    char operation;
+    unsigned long long int address;
+    int size;
+    int tid;
+    int core;
+
+    csim_default_config(&cfg);
+
+    /*save command line argument*/
+    while((opt = getopt(argc, argv, "hvs:E:b:t:w:a:c:C:p:d:rn:g:T:")) != -1){
+        switch(opt){
+            case 'h':
+            usage();
+            return 0;
+            case 'v':
+            cfg.display = true;
+            break;
+            case 's':
+            cfg.s = atoi(optarg);
+            break;
+            case 'E':
+            cfg.E = atoi(optarg);
+            break;
+            case 'b':
+            cfg.b = atoi(optarg);
+            break;
+            case 't':
+            t = optarg;
+            break;
+            case 'w':
+            if(!strcmp(optarg, "wb")){
+                cfg.write_back = true;
+            }
+            else if(!strcmp(optarg, "wt")){
+                cfg.write_back = false;
+            }
+            else{
+                usage();
+                return 1;
+            }
+            break;
+            case 'a':
+            if(!strcmp(optarg, "wa")){
+                cfg.write_allocate = true;
+            }
+            else if(!strcmp(optarg, "nwa")){
+                cfg.write_allocate = false;
+            }
+            else{
+                usage();
+                return 1;
+            }
+            break;
+            case 'c':
+            cfg.ncores = atoi(optarg);
+            break;
+            case 'C':
+            if(!strcmp(optarg, "mesi")){
+                cfg.moesi = false;
+            }
+            else if(!strcmp(optarg, "moesi")){
+                cfg.moesi = true;
+            }
+            else{
+                usage();
+                return 1;
+            }
+            break;
+            case 'p':
+            if(!strcmp(optarg, "none")){
+                cfg.prefetcher = CSIM_PF_NONE;
+            }
+            else if(!strcmp(optarg, "next")){
+                cfg.prefetcher = CSIM_PF_NEXT;
+            }
+            else if(!strcmp(optarg, "stride")){
+                cfg.prefetcher = CSIM_PF_STRIDE;
+            }
+            else if(!strcmp(optarg, "stream")){
+                cfg.prefetcher = CSIM_PF_STREAM;
+            }
+            else{
+                usage();
+                return 1;
+            }
+            break;
+            case 'd':
+            cfg.degree = atoi(optarg);
+            break;
+            case 'r':
+            cfg.report = true;
+            break;
+            case 'n':
+            cfg.top_n = atoi(optarg);
+            break;
+            case 'g':
+            if(!strcmp(optarg, "4k")){
+                cfg.page_shift = 12;
+            }
+            else if(!strcmp(optarg, "2m")){
+                cfg.page_shift = 21;
+            }
+            else if(!strcmp(optarg, "1g")){
+                cfg.page_shift = 30;
+            }
+            else{
+                usage();
+                return 1;
+            }
+            break;
+            case 'T':
+            if(sscanf(optarg, "%d,%d,%d,%d", &cfg.dtlb_entries, &cfg.dtlb_ways,
+                      &cfg.stlb_entries, &cfg.stlb_ways) != 4){
+                usage();
+                return 1;
+            }
+            if(cfg.page_shift == 0){
+                cfg.page_shift = 12;
+            }
+            break;
+            default:
+            usage();
+            return 1;
+        }
+
+    }
+
+    if(cfg.s < 0 || cfg.E <= 0 || cfg.b < 0 || cfg.s + cfg.b >= 63 || t == NULL ||
+       cfg.ncores < 1 || cfg.ncores > CSIM_MAXCORES || cfg.degree < 0 || cfg.top_n < 0){
+        usage();
+        return 1;
+    }
+    err = csim_check_config(&cfg);
+    if(err != NULL){
+        printf("%s\n", err);
+        return 1;
+    }
+
+    sim = csim_create(&cfg);
+    if(sim == NULL){
+        printf("cache allocation failed\n");
+        return 1;
+    }
+
+    /*trace file reading*/
+    trace = fopen(t,"r");
+    if(trace == NULL){
+        printf("%s: No such file\n", t);
+        csim_free(sim);
+        return 1;
+    }
+
+    while(fgets(buf, sizeof(buf), trace) != NULL){
+
+        /*multi-core traces prefix every record with its thread id*/
+        if(cfg.ncores > 1){
+            if(sscanf(buf, " %d %c %llx, %d", &tid, &operation, &address, &size) != 4 || tid < 0){
+                continue;
+            }
+            core = tid % cfg.ncores;
+        }
+        else{
+            if(sscanf(buf, " %c %llx, %d", &operation, &address, &size) != 3){
+                continue;
+            }
+            core = 0;
+        }
+
+        if(operation == 'I'){ // instruction loads are not simulated
+            continue;
+        }
+
+        if(cfg.display == true){
+            if(cfg.ncores > 1){
+                printf("%d ", core);
+            }
+            printf("%c %llx,%d ", operation, address, size);
+        }
+
+        if(csim_access(sim, core, operation, address, size) != 0){
+            printf("out of memory for the line or page tables\n");
+            fclose(trace);
+            csim_free(sim);
+            return 1;
+        }
+
+        if(cfg.display == true){
+            printf("\n");
+        }
+    }
+
+    fclose(trace); // file close
+
+    csim_snapshot(sim, &st);
+    printSummary((int)st.hits, (int)st.misses, (int)st.evictions);
+    csim_print_report(sim);
+
+    csim_free(sim);
+
+    return 0;
+}
+
+void usage(void){
+    printf("Usage: ./csim-ref [-hv] -s <s> -E <E> -b <b> -t <tracefile> [-w wb|wt] [-a wa|nwa]\n");
+    printf("                  [-c <cores> [-C mesi|moesi]] [-p none|next|stride|stream [-d <degree>]]\n");
+    printf("                  [-r [-n <N>]] [-g 4k|2m|1g] [-T <dtlb>,<ways>,<stlb>,<ways>]\n");
+    printf("  -w  write hits back on eviction (wb, default) or through to memory (wt)\n");
+    printf("  -a  allocate a line on a store miss (wa, default) or not (nwa)\n");
+    printf("  -c  simulate <cores> private caches; trace records start with a thread id\n");
+    printf("  -C  coherence protocol between the cores (mesi, default, or moesi)\n");
+    printf("  -p  hardware prefetcher (none, default, next-line, stride or stream buffers)\n");
+    printf("  -d  blocks prefetched ahead, or stream buffer depth (default 1, 4 for stream)\n");
+    printf("  -r  report where the misses come from: top lines, per-set heatmap, 3C classes\n");
+    printf("  -n  lines (and sets) listed in reports (default 10)\n");
+    printf("  -g  translate addresses through TLBs with this page size before the cache\n");
+    printf("  -T  TLB entries and ways, L1 dTLB then STLB (default 64,4,1536,12)\n");
+}
@@ -0,0 +1,591 @@
+/* 20220124 Moonkyeom Kim
+ * trans.c - Matrix transpose B = A^T
+ *
+ * Each transpose function must have a prototype of the form:
+ * void trans(int M, int N, int A[N][M], int B[M][N]);
+ *
+ * A transpose function is evaluated by counting the number of misses
+ * on a 1KB direct mapped cache with a block size of 32 bytes.
+ */ 
+#include <stdio.h>
+#include "cachelab.h"
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+/*cache the transposes are tuned for*/
+#define CACHE_BYTES 1024
+#define BLOCK_BYTES 32
+#define LINE_INTS (BLOCK_BYTES / (int)sizeof(int)) // ints sharing one block
+
+/*outer blocking of transpose_simd: a 64x64 int tile of A and of B stay in L1*/
+#define SIMD_BLOCK 64
+
+int is_transpose(int M, int N, int A[N][M], int B[M][N]);
+void transpose_blocked(int M, int N, int A[N][M], int B[M][N]);
+
+/* 
+ * transpose_submit - This is the solution transpose function that you
+ *     will be graded on for Part B of the assignment. Do not change
+ *     the description string "Transpose submission", as the driver
+ *     searches for that string to identify the transpose function to
+ *     be graded. 
+ */
+char transpose_submit_desc[] = "Transpose submission";
+void transpose_submit(int M, int N, int A[N][M], int B[M][N])
+{
+        if (M == 32 && N == 32)
+    {
+        int temp;
+
+        for (int i = 0; i < 32; i += 8)
+        {
+            for (int j = 0; j < 32; j += 8)
+            {
+                for (int il = i; il < i + 8; il++)
+                {
+                    for (int jl = j; jl < j + 8; jl++)
+                    {
+                        if (jl == il)
+                        {
+                            temp = A[il][jl];
+                        }
+                        if (jl != il)
+                        {
+                            B[jl][il] = A[il][jl];
+                        }
+                    }
+                    if (i == j)
+                    {
+                        B[il][il] = temp;
+                    }
+                }
+            }
+        }
+    }
+
+    if (M == 64 && N == 64)
+    {
+        int tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+        for (int i = 0; i < 64; i += 8)
+        {
+            for (int j = 0; j < 64; j += 8)
+            {
+                for (int il = i; il < i + 4; il++)
+                {
+                    tmp0 = A[il][j];
+                    tmp1 = A[il][j + 1];
+                    tmp2 = A[il][j + 2];
+                    tmp3 = A[il][j + 3];
+                    tmp4 = A[il][j + 4];
+                    tmp5 = A[il][j + 5];
+                    tmp6 = A[il][j + 6];
+                    tmp7 = A[il][j + 7];
+
+                    B[j][il] = tmp0;
+                    B[j + 1][il] = tmp1;
+                    B[j + 2][il] = tmp2;
+                    B[j + 3][il] = tmp3;
+                    B[j][il + 4] = tmp4;
+                    B[j + 1][il + 4] = tmp5;
+                    B[j + 2][il + 4] = tmp6;
+                    B[j + 3][il + 4] = tmp7;
+                }
+
+                for(int jl = j; jl < j + 4; jl++){
+                    tmp4 = A[i + 4][jl];
+                    tmp5 = A[i + 5][jl];
+                    tmp6 = A[i + 6][jl];
+                    tmp7 = A[i + 7][jl];
+
+                    tmp0 = B[jl][i + 4];
+                    tmp1 = B[jl][i + 5];
+                    tmp2 = B[jl][i + 6];
+                    tmp3 = B[jl][i + 7];
+
+                    B[jl][i + 4] = tmp4;
+                    B[jl][i + 5] = tmp5;
+                    B[jl][i + 6] = tmp6;
+                    B[jl][i + 7] = tmp7;
+
+                    B[jl + 4][i] = tmp0;
+                    B[jl + 4][i + 1] = tmp1;
+                    B[jl + 4][i + 2] = tmp2;
+                    B[jl + 4][i + 3] = tmp3;
+                
+
+
+                }
+
+                for (int il = i; il < i + 4; il++)
+                {
+                    tmp0 = A[il + 4][j + 4];
+                    tmp1 = A[il + 4][j + 5];
+                    tmp2 = A[il + 4][j + 6];
+                    tmp3 = A[il + 4][j + 7];
+
+                    B[j + 4][il + 4] = tmp0;
+                    B[j + 5][il + 4] = tmp1;
+                    B[j + 6][il + 4] = tmp2;
+                    B[j + 7][il + 4] = tmp3;
+                }
+            }
+        }
+    }
+
+    if (M == 61 && N == 67)
+    {
+        int temp;
+
+        for (int i = 0; i < 67; i += 8)
+        {
+            for (int j = 0; j < 61; j += 8)
+            {
+                for (int il = i; il < 67 && il < i + 8; il++)
+                {
+                    for (int jl = j; jl < 61 && jl < j + 8; jl++)
+                    {
+                        if (jl == il)
+                        {
+                            temp = A[il][jl];
+                        }
+                        if (jl != il)
+                        {
+                            B[jl][il] = A[il][jl];
+                        }
+                    }
+                    if (i == j)
+                    {
+                        B[il][il] = temp;
+                    }
+                }
+            }
+        } 
+    }
+
+    if (!(M == 32 && N == 32) && !(M == 64 && N == 64) && !(M == 61 && N == 67))
+    {
+        transpose_blocked(M, N, A, B);
+    }
+
+    return;
+}
+
+/*
+ * conflict_rows - how many consecutive rows of `stride` ints fit in the
+ *     cache before one lands in the same block frame as the first one.
+ *     Capped at LINE_INTS, the widest tile worth using.
+ */
+static int conflict_rows(int stride)
+{
+    int k, offset;
+
+    for (k = 1; k < LINE_INTS; k++)
+    {
+        offset = (int)((long)k * stride * (int)sizeof(int) % CACHE_BYTES);
+        if (offset < BLOCK_BYTES || offset > CACHE_BYTES - BLOCK_BYTES)
+        {
+            return k;
+        }
+    }
+    return LINE_INTS;
+}
+
+/*
+ * transpose_tile - transpose rows r0..r1-1, columns c0..c1-1 of A.
+ *     The diagonal element is copied last: on a diagonal tile A[il] and
+ *     B[il] map to the same frame, and writing B[il][il] in the middle
+ *     of the row would evict the A line still being read.
+ */
+static void transpose_tile(int M, int N, int A[N][M], int B[M][N], int r0, int r1, int c0, int c1)
+{
+    int temp = 0;
+
+    for (int il = r0; il < r1; il++)
+    {
+        for (int jl = c0; jl < c1; jl++)
+        {
+            if (jl == il)
+            {
+                temp = A[il][jl];
+            }
+            if (jl != il)
+            {
+                B[jl][il] = A[il][jl];
+            }
+        }
+        if (il >= c0 && il < c1)
+        {
+            B[il][il] = temp;
+        }
+    }
+}
+
+/*
+ * transpose_split - the 64x64 scheme for the 8x8 tile at (i, j), for
+ *     shapes where only four rows of B fit in the cache at once. The
+ *     upper right 4x4 of B is parked in the lower left's place and moved
+ *     while the lower left of A is read, so no line is loaded twice.
+ */
+static void transpose_split(int M, int N, int A[N][M], int B[M][N], int i, int j)
+{
+    int tmp0, tmp1, tmp2, tmp3, tmp4, tmp5, tmp6, tmp7;
+
+    for (int il = i; il < i + 4; il++)
+    {
+        tmp0 = A[il][j];
+        tmp1 = A[il][j + 1];
+        tmp2 = A[il][j + 2];
+        tmp3 = A[il][j + 3];
+        tmp4 = A[il][j + 4];
+        tmp5 = A[il][j + 5];
+        tmp6 = A[il][j + 6];
+        tmp7 = A[il][j + 7];
+
+        B[j][il] = tmp0;
+        B[j + 1][il] = tmp1;
+        B[j + 2][il] = tmp2;
+        B[j + 3][il] = tmp3;
+        B[j][il + 4] = tmp4;
+        B[j + 1][il + 4] = tmp5;
+        B[j + 2][il + 4] = tmp6;
+        B[j + 3][il + 4] = tmp7;
+    }
+
+    for (int jl = j; jl < j + 4; jl++)
+    {
+        tmp4 = A[i + 4][jl];
+        tmp5 = A[i + 5][jl];
+        tmp6 = A[i + 6][jl];
+        tmp7 = A[i + 7][jl];
+
+        tmp0 = B[jl][i + 4];
+        tmp1 = B[jl][i + 5];
+        tmp2 = B[jl][i + 6];
+        tmp3 = B[jl][i + 7];
+
+        B[jl][i + 4] = tmp4;
+        B[jl][i + 5] = tmp5;
+        B[jl][i + 6] = tmp6;
+        B[jl][i + 7] = tmp7;
+
+        B[jl + 4][i] = tmp0;
+        B[jl + 4][i + 1] = tmp1;
+        B[jl + 4][i + 2] = tmp2;
+        B[jl + 4][i + 3] = tmp3;
+    }
+
+    for (int il = i; il < i + 4; il++)
+    {
+        tmp0 = A[il + 4][j + 4];
+        tmp1 = A[il + 4][j + 5];
+        tmp2 = A[il + 4][j + 6];
+        tmp3 = A[il + 4][j + 7];
+
+        B[j + 4][il + 4] = tmp0;
+        B[j + 5][il + 4] = tmp1;
+        B[j + 6][il + 4] = tmp2;
+        B[j + 7][il + 4] = tmp3;
+    }
+}
+
+/*
+ * use_split - whether full tiles of an M x N transpose should use the
+ *     split scheme: four rows fit, and the shape is not a square with
+ *     eight free rows (the 32x32 case, where the diagonal tiles of A and
+ *     B share frames and only the diagonal trick in transpose_tile works)
+ */
+static int use_split(int M, int N)
+{
+    int rows = conflict_rows(M) < conflict_rows(N) ? conflict_rows(M) : conflict_rows(N);
+
+    return rows >= LINE_INTS / 2 && !(M == N && rows == LINE_INTS);
+}
+
+/*
+ * transpose_split_tile - one tile of a split shape: a full 8x8 goes to
+ *     transpose_split, an edge tile to transpose_tile four rows at a
+ *     time, which keeps its rows of B inside the cache
+ */
+static void transpose_split_tile(int M, int N, int A[N][M], int B[M][N], int r0, int r1, int c0, int c1)
+{
+    if (r1 - r0 == LINE_INTS && c1 - c0 == LINE_INTS)
+    {
+        transpose_split(M, N, A, B, r0, c0);
+        return;
+    }
+    for (int il = r0; il < r1; il += LINE_INTS / 2)
+    {
+        transpose_tile(M, N, A, B, il, il + LINE_INTS / 2 < r1 ? il + LINE_INTS / 2 : r1, c0, c1);
+    }
+}
+
+/*
+ * transpose_split_tiles - the whole matrix in 8x8 split tiles. Kept
+ *     apart from transpose_blocked so only i and j are live on top of
+ *     transpose_split's nine ints: the chain from transpose_submit stays
+ *     within the lab's twelve.
+ */
+static void transpose_split_tiles(int M, int N, int A[N][M], int B[M][N])
+{
+    for (int i = 0; i < N; i += LINE_INTS)
+    {
+        for (int j = 0; j < M; j += LINE_INTS)
+        {
+            transpose_split_tile(M, N, A, B, i, i + LINE_INTS < N ? i + LINE_INTS : N,
+                                 j, j + LINE_INTS < M ? j + LINE_INTS : M);
+        }
+    }
+}
+
+/*
+ * transpose_blocked - any M x N. The tile is one block wide and as tall
+ *     as the rows of A and B that can share the cache without conflict.
+ *     Full tiles use the 64x64 split scheme whenever four rows fit; it
+ *     also saves misses on shapes where eight would. Square shapes with
+ *     eight free rows keep plain 8x8 tiles (the 32x32 case). Below four
+ *     rows, tiles shrink.
+ */
+char transpose_blocked_desc[] = "Blocked transpose, tile from cache parameters";
+void transpose_blocked(int M, int N, int A[N][M], int B[M][N])
+{
+    int tile = conflict_rows(M) < conflict_rows(N) ? conflict_rows(M) : conflict_rows(N);
+
+    if (use_split(M, N))
+    {
+        transpose_split_tiles(M, N, A, B);
+        return;
+    }
+
+    for (int i = 0; i < N; i += tile)
+    {
+        for (int j = 0; j < M; j += tile)
+        {
+            transpose_tile(M, N, A, B, i, i + tile < N ? i + tile : N, j, j + tile < M ? j + tile : M);
+        }
+    }
+}
+
+/*
+ * transpose_rec - cache-oblivious: halve the longer side (at a multiple
+ *     of LINE_INTS, so tiles stay block aligned) until the piece is one
+ *     tile, without knowing anything else about the cache. With split
+ *     set the leaves go through transpose_split_tile, as transpose_blocked
+ *     does for the same shapes.
+ */
+static void transpose_rec(int M, int N, int A[N][M], int B[M][N], int r0, int r1, int c0, int c1, int split)
+{
+    int mid;
+
+    if (r1 - r0 <= LINE_INTS && c1 - c0 <= LINE_INTS)
+    {
+        if (split)
+        {
+            transpose_split_tile(M, N, A, B, r0, r1, c0, c1);
+        }
+        else
+        {
+            transpose_tile(M, N, A, B, r0, r1, c0, c1);
+        }
+        return;
+    }
+
+    if (r1 - r0 >= c1 - c0)
+    {
+        mid = r0 + ((r1 - r0) / 2 + LINE_INTS - 1) / LINE_INTS * LINE_INTS;
+        transpose_rec(M, N, A, B, r0, mid, c0, c1, split);
+        transpose_rec(M, N, A, B, mid, r1, c0, c1, split);
+    }
+    else
+    {
+        mid = c0 + ((c1 - c0) / 2 + LINE_INTS - 1) / LINE_INTS * LINE_INTS;
+        transpose_rec(M, N, A, B, r0, r1, c0, mid, split);
+        transpose_rec(M, N, A, B, r0, r1, mid, c1, split);
+    }
+}
+
+char transpose_oblivious_desc[] = "Cache-oblivious recursive transpose";
+void transpose_oblivious(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_rec(M, N, A, B, 0, N, 0, M, use_split(M, N));
+}
+
+#if defined(__AVX2__)
+#define SIMD_TILE 8
+/*
+ * transpose_kernel - 8x8 tile at (i, j) in registers: 32-bit unpacks
+ *     pair up rows, 64-bit unpacks make 4x4 quarters, and the 128-bit
+ *     permutes swap the off-diagonal quarters
+ */
+static void transpose_kernel(int M, int N, int A[N][M], int B[M][N], int i, int j)
+{
+    __m256i r0 = _mm256_loadu_si256((const __m256i *)&A[i][j]);
+    __m256i r1 = _mm256_loadu_si256((const __m256i *)&A[i + 1][j]);
+    __m256i r2 = _mm256_loadu_si256((const __m256i *)&A[i + 2][j]);
+    __m256i r3 = _mm256_loadu_si256((const __m256i *)&A[i + 3][j]);
+    __m256i r4 = _mm256_loadu_si256((const __m256i *)&A[i + 4][j]);
+    __m256i r5 = _mm256_loadu_si256((const __m256i *)&A[i + 5][j]);
+    __m256i r6 = _mm256_loadu_si256((const __m256i *)&A[i + 6][j]);
+    __m256i r7 = _mm256_loadu_si256((const __m256i *)&A[i + 7][j]);
+
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+    __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+    __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+    r0 = _mm256_unpacklo_epi64(t0, t2);
+    r1 = _mm256_unpackhi_epi64(t0, t2);
+    r2 = _mm256_unpacklo_epi64(t1, t3);
+    r3 = _mm256_unpackhi_epi64(t1, t3);
+    r4 = _mm256_unpacklo_epi64(t4, t6);
+    r5 = _mm256_unpackhi_epi64(t4, t6);
+    r6 = _mm256_unpacklo_epi64(t5, t7);
+    r7 = _mm256_unpackhi_epi64(t5, t7);
+
+    _mm256_storeu_si256((__m256i *)&B[j][i], _mm256_permute2x128_si256(r0, r4, 0x20));
+    _mm256_storeu_si256((__m256i *)&B[j + 1][i], _mm256_permute2x128_si256(r1, r5, 0x20));
+    _mm256_storeu_si256((__m256i *)&B[j + 2][i], _mm256_permute2x128_si256(r2, r6, 0x20));
+    _mm256_storeu_si256((__m256i *)&B[j + 3][i], _mm256_permute2x128_si256(r3, r7, 0x20));
+    _mm256_storeu_si256((__m256i *)&B[j + 4][i], _mm256_permute2x128_si256(r0, r4, 0x31));
+    _mm256_storeu_si256((__m256i *)&B[j + 5][i], _mm256_permute2x128_si256(r1, r5, 0x31));
+    _mm256_storeu_si256((__m256i *)&B[j + 6][i], _mm256_permute2x128_si256(r2, r6, 0x31));
+    _mm256_storeu_si256((__m256i *)&B[j + 7][i], _mm256_permute2x128_si256(r3, r7, 0x31));
+}
+#elif defined(__SSE2__)
+#define SIMD_TILE 4
+/*
+ * transpose_kernel - 4x4 tile at (i, j) in registers (SSE2 only)
+ */
+static void transpose_kernel(int M, int N, int A[N][M], int B[M][N], int i, int j)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)&A[i][j]);
+    __m128i r1 = _mm_loadu_si128((const __m128i *)&A[i + 1][j]);
+    __m128i r2 = _mm_loadu_si128((const __m128i *)&A[i + 2][j]);
+    __m128i r3 = _mm_loadu_si128((const __m128i *)&A[i + 3][j]);
+
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t2 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    _mm_storeu_si128((__m128i *)&B[j][i], _mm_unpacklo_epi64(t0, t2));
+    _mm_storeu_si128((__m128i *)&B[j + 1][i], _mm_unpackhi_epi64(t0, t2));
+    _mm_storeu_si128((__m128i *)&B[j + 2][i], _mm_unpacklo_epi64(t1, t3));
+    _mm_storeu_si128((__m128i *)&B[j + 3][i], _mm_unpackhi_epi64(t1, t3));
+}
+#endif
+
+/*
+ * transpose_simd_cols - columns c0..c1-1 of A (rows c0..c1-1 of B), for
+ *     real hardware rather than the 1KB model: the SIMD_BLOCK x
+ *     SIMD_BLOCK outer blocks keep both tiles in L1, the inner tiles go
+ *     through transpose_kernel and the ragged edges through
+ *     transpose_tile. Without SSE2 every tile is a LINE_INTS square
+ *     transpose_tile. transpose_blocked is not used there: it cannot take
+ *     a column range, and its tile is sized for the 1KB model, which
+ *     leaves one row on power-of-two widths.
+ */
+void transpose_simd_cols(int M, int N, int A[N][M], int B[M][N], int c0, int c1)
+{
+#ifdef SIMD_TILE
+    int rows = N - N % SIMD_TILE;
+    int cols = c1 - (c1 - c0) % SIMD_TILE;
+
+    for (int i = 0; i < rows; i += SIMD_BLOCK)
+    {
+        for (int j = c0; j < cols; j += SIMD_BLOCK)
+        {
+            for (int il = i; il < rows && il < i + SIMD_BLOCK; il += SIMD_TILE)
+            {
+                for (int jl = j; jl < cols && jl < j + SIMD_BLOCK; jl += SIMD_TILE)
+                {
+                    transpose_kernel(M, N, A, B, il, jl);
+                }
+            }
+        }
+    }
+    transpose_tile(M, N, A, B, 0, rows, cols, c1);
+    transpose_tile(M, N, A, B, rows, N, c0, c1);
+#else
+    for (int i = 0; i < N; i += LINE_INTS)
+    {
+        for (int j = c0; j < c1; j += LINE_INTS)
+        {
+            transpose_tile(M, N, A, B, i, i + LINE_INTS < N ? i + LINE_INTS : N,
+                           j, j + LINE_INTS < c1 ? j + LINE_INTS : c1);
+        }
+    }
+#endif
+}
+
+char transpose_simd_desc[] = "SIMD register-tile transpose";
+void transpose_simd(int M, int N, int A[N][M], int B[M][N])
+{
+    transpose_simd_cols(M, N, A, B, 0, M);
+}
+
+/* 
+ * You can define additional transpose functions below. We've defined
+ * a simple one below to help you get started. 
+ */ 
+
+/* 
+ * trans - A simple baseline transpose function, not optimized for the cache.
+ */
+char trans_desc[] = "Simple row-wise scan transpose";
+void trans(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j, tmp;
+
+    for (i = 0; i < N; i++) {
+        for (j = 0; j < M; j++) {
+            tmp = A[i][j];
+            B[j][i] = tmp;
+        }
+    }    
+
+}
+
+/*
+ * registerFunctions - This function registers your transpose
+ *     functions with the driver.  At runtime, the driver will
+ *     evaluate each of the registered functions and summarize their
+ *     performance. This is a handy way to experiment with different
+ *     transpose strategies.
+ */
+void registerFunctions()
+{
+    /* Register your solution function */
+    registerTransFunction(transpose_submit, transpose_submit_desc); 
+
+    /* Register any additional transpose functions */
+    registerTransFunction(trans, trans_desc); 
+    registerTransFunction(transpose_blocked, transpose_blocked_desc);
+    registerTransFunction(transpose_oblivious, transpose_oblivious_desc);
+    registerTransFunction(transpose_simd, transpose_simd_desc);
+
+}
+
+/* 
+ * is_transpose - This helper function checks if B is the transpose of
+ *     A. You can check the correctness of your transpose by calling
+ *     it before returning from the transpose function.
+ */
+int is_transpose(int M, int N, int A[N][M], int B[M][N])
+{
+    int i, j;
+
+    for (i = 0; i < N; i++) {
+        for (j = 0; j < M; ++j) {
+            if (A[i][j] != B[j][i]) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
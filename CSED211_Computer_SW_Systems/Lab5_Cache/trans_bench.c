@@ -0,0 +1,231 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * trans_bench.c - wall-clock timing of the transposes in trans.c on
+ *     matrices far larger than the 1KB cache they were tuned for
+ *
+ * build: gcc -O2 -march=native -pthread -o trans_bench trans_bench.c trans.c trans_par.c \
+ *            trans_inplace.c cachelab.c
+ * usage: ./trans_bench [-r <reps>] [-t <threads> [-f]] [-i] [<M> <N> ...]
+ *     -t  also time transpose_parallel from 1 to <threads> threads
+ *     -f  place B with first_touch before the parallel runs
+ *     -i  also time transpose_inplace, with the memory it needs beside A
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include "cachelab.h"
+
+void transpose_submit(int M, int N, int A[N][M], int B[M][N]);
+void trans(int M, int N, int A[N][M], int B[M][N]);
+void transpose_blocked(int M, int N, int A[N][M], int B[M][N]);
+void transpose_oblivious(int M, int N, int A[N][M], int B[M][N]);
+void transpose_simd(int M, int N, int A[N][M], int B[M][N]);
+int is_transpose(int M, int N, int A[N][M], int B[M][N]);
+void transpose_parallel(int M, int N, int A[N][M], int B[M][N], int threads);
+void first_touch(int M, int N, int B[M][N], int threads);
+int transpose_inplace(int M, int N, int *A);
+
+typedef void (*trans_fn)(int M, int N, int A[N][M], int B[M][N]);
+
+struct{
+    trans_fn fn;
+    const char *name;
+} funcs[] = {
+    {trans, "trans"},
+    {transpose_submit, "transpose_submit"},
+    {transpose_blocked, "transpose_blocked"},
+    {transpose_oblivious, "transpose_oblivious"},
+    {transpose_simd, "transpose_simd"},
+};
+#define NFUNCS (int)(sizeof(funcs) / sizeof(funcs[0]))
+
+/*default shapes: powers of two (worst set conflicts) and ragged edges*/
+int shapes[][2] = {{1024, 1024}, {2048, 2048}, {4096, 4096}, {3000, 5000}, {1023, 1025}};
+#define NSHAPES (int)(sizeof(shapes) / sizeof(shapes[0]))
+
+static double now(void){
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int reps = 5;
+int max_threads = 0;
+bool numa = false;
+bool inplace = false;
+
+/*
+ * scaling - transpose_parallel on 1, 2, 4 ... max_threads threads, each
+ *     count with a fresh B so first_touch can place it
+ */
+static void scaling(int M, int N, int *A){
+
+    double base = 0;
+
+    for(int step = 1; ; step *= 2){
+        int threads = step < max_threads ? step : max_threads;
+        int *B = malloc(sizeof(int) * (size_t)M * N);
+        double best = 1e30;
+
+        if(B == NULL){
+            printf("%dx%d: allocation failed\n", M, N);
+            return;
+        }
+        if(numa){
+            first_touch(M, N, (int (*)[N])B, threads);
+        }
+        else{
+            memset(B, 0xff, sizeof(int) * (size_t)M * N); // malloc may hand back the last B, already right
+        }
+        for(int r = 0; r < reps; r++){
+            double start = now();
+            double elapsed;
+
+            transpose_parallel(M, N, (int (*)[M])A, (int (*)[N])B, threads);
+            elapsed = now() - start;
+            if(elapsed < best){
+                best = elapsed;
+            }
+        }
+        if(threads == 1){
+            base = best;
+        }
+        printf("%5dx%-5d parallel %2d threads%s %9.3f ms %7.2f GB/s x%.2f %s\n", M, N, threads,
+               numa ? " (first touch)" : "", best * 1e3, 2.0 * sizeof(int) * M * N / best * 1e-9, base / best,
+               is_transpose(M, N, (int (*)[M])A, (int (*)[N])B) ? "" : "WRONG");
+        free(B);
+        if(threads == max_threads){
+            break;
+        }
+    }
+}
+
+/*
+ * in_place - transpose_inplace on a copy of A, against the extra memory
+ *     an out-of-place transpose needs (all of B)
+ */
+static void in_place(int M, int N, int *A){
+
+    size_t size = (size_t)M * N;
+    int *C = malloc(sizeof(int) * size);
+    double best = 1e30;
+    size_t extra = M == N || M <= 1 || N <= 1 ? 0 : size / 8 + 1; // the cycle bitmap
+
+    if(C == NULL){
+        printf("%dx%d: allocation failed\n", M, N);
+        return;
+    }
+    for(int r = 0; r < reps; r++){
+        double start, elapsed;
+
+        memcpy(C, A, sizeof(int) * size);
+        start = now();
+        if(transpose_inplace(M, N, C) != 0){
+            printf("%dx%d: bitmap allocation failed\n", M, N);
+            break;
+        }
+        elapsed = now() - start;
+        if(elapsed < best){
+            best = elapsed;
+        }
+    }
+    printf("%5dx%-5d %-20s %9.3f ms %7.2f GB/s extra %zu KB (out of place %zu KB) %s\n", M, N,
+           "transpose_inplace", best * 1e3, 2.0 * sizeof(int) * size / best * 1e-9, extra >> 10,
+           (sizeof(int) * size) >> 10, is_transpose(M, N, (int (*)[M])A, (int (*)[N])C) ? "" : "WRONG");
+    free(C);
+}
+
+/*
+ * bench - best of `reps` runs of every transpose on one M x N matrix
+ */
+static void bench(int M, int N){
+
+    int *A = malloc(sizeof(int) * (size_t)M * N);
+    int *B = malloc(sizeof(int) * (size_t)M * N);
+    double bytes = 2.0 * sizeof(int) * M * N; // read A once, write B once
+
+    if(A == NULL || B == NULL){
+        printf("%dx%d: allocation failed\n", M, N);
+        free(A);
+        free(B);
+        return;
+    }
+    for(size_t i = 0; i < (size_t)M * N; i++){
+        A[i] = (int)i;
+    }
+
+    for(int f = 0; f < NFUNCS; f++){
+        double best = 1e30;
+
+        // fault B in before timing, and fill it with -1, in no transpose of A, so a missed B[j][i] shows
+        memset(B, 0xff, sizeof(int) * (size_t)M * N);
+        for(int r = 0; r < reps; r++){
+            double start = now();
+            double elapsed;
+
+            funcs[f].fn(M, N, (int (*)[M])A, (int (*)[N])B);
+            elapsed = now() - start;
+            if(elapsed < best){
+                best = elapsed;
+            }
+        }
+        printf("%5dx%-5d %-20s %9.3f ms %7.2f GB/s %s\n", M, N, funcs[f].name, best * 1e3,
+               bytes / best * 1e-9, is_transpose(M, N, (int (*)[M])A, (int (*)[N])B) ? "" : "WRONG");
+    }
+
+    if(max_threads > 0){
+        scaling(M, N, A);
+    }
+    if(inplace){
+        in_place(M, N, A);
+    }
+
+    free(A);
+    free(B);
+}
+
+int main(int argc, char *argv[])
+{
+
+    int opt;
+
+    while((opt = getopt(argc, argv, "r:t:fi")) != -1){
+        switch(opt){
+            case 'r':
+            reps = atoi(optarg);
+            break;
+            case 't':
+            max_threads = atoi(optarg);
+            break;
+            case 'f':
+            numa = true;
+            break;
+            case 'i':
+            inplace = true;
+            break;
+            default:
+            printf("usage: %s [-r <reps>] [-t <threads> [-f]] [-i] [<M> <N> ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(reps < 1 || max_threads < 0 || (argc - optind) % 2){
+        printf("usage: %s [-r <reps>] [-t <threads> [-f]] [-i] [<M> <N> ...]\n", argv[0]);
+        return 1;
+    }
+
+    if(optind == argc){
+        for(int k = 0; k < NSHAPES; k++){
+            bench(shapes[k][0], shapes[k][1]);
+        }
+    }
+    for(int k = optind; k + 1 < argc; k += 2){
+        bench(atoi(argv[k]), atoi(argv[k + 1]));
+    }
+
+    return 0;
+}
@@ -0,0 +1,92 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * trans_inplace.c - in-place transpose: the N x M matrix in A becomes
+ *     its M x N transpose in the same buffer, with no B
+ *
+ * Square matrices swap tile pairs across the diagonal. Rectangular ones
+ * follow the permutation's cycles, with a bitmap of one bit per element
+ * marking what has already been moved (MN/8 bytes instead of a second
+ * MN*4-byte matrix). Lives outside trans.c because it allocates.
+ */
+#include <stdlib.h>
+
+#define TILE 8 // ints per 32-byte block, as LINE_INTS in trans.c
+
+int transpose_inplace(int M, int N, int *A);
+
+/*
+ * swap_square - blocked in-place transpose of an n x n matrix. Tile
+ *     (i, j) above the diagonal is swapped with tile (j, i) below it, so
+ *     both tiles are read and written while their lines are cached.
+ */
+static void swap_square(int n, int A[n][n]){
+
+    int tmp;
+
+    for(int i = 0; i < n; i += TILE){
+        for(int j = i; j < n; j += TILE){
+            for(int il = i; il < n && il < i + TILE; il++){
+                for(int jl = (i == j ? il + 1 : j); jl < n && jl < j + TILE; jl++){
+                    tmp = A[il][jl];
+                    A[il][jl] = A[jl][il];
+                    A[jl][il] = tmp;
+                }
+            }
+        }
+    }
+}
+
+/*
+ * follow_cycles - in-place transpose of an N x M matrix. Element k =
+ *     i*M + j belongs at j*N + i, which is k*N mod (MN - 1) for every k
+ *     but the last. Each unvisited start is carried around its cycle.
+ */
+static int follow_cycles(int M, int N, int *A){
+
+    size_t size = (size_t)M * N;
+    size_t last = size - 1;
+    unsigned char *moved = calloc(size / 8 + 1, 1);
+
+    if(moved == NULL){
+        return -1;
+    }
+
+    for(size_t start = 1; start < last; start++){
+        size_t k = start;
+        int carry;
+
+        if(moved[start >> 3] & (1 << (start & 7))){
+            continue;
+        }
+
+        carry = A[start];
+        do{
+            size_t next = (size_t)((unsigned long long)k * N % last);
+            int tmp = A[next];
+
+            A[next] = carry;
+            carry = tmp;
+            moved[next >> 3] |= 1 << (next & 7);
+            k = next;
+        }while(k != start);
+    }
+
+    free(moved);
+    return 0;
+}
+
+/*
+ * transpose_inplace - returns 0, or -1 if the bitmap could not be
+ *     allocated (A is then unchanged)
+ */
+int transpose_inplace(int M, int N, int *A){
+
+    if(M <= 1 || N <= 1){ // a single row or column reads the same either way
+        return 0;
+    }
+    if(M == N){
+        swap_square(M, (int (*)[M])A);
+        return 0;
+    }
+    return follow_cycles(M, N, A);
+}
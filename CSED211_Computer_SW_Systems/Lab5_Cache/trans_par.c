@@ -0,0 +1,183 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * trans_par.c - transpose_simd spread over a pool of threads
+ *
+ * Thread k owns a contiguous band of columns of A, i.e. a contiguous
+ * band of rows of B. Band edges are multiples of SIMD_BLOCK (64) rows
+ * of B, i.e. of 256 * N bytes, so with a line-aligned B every destination
+ * line is written by exactly one thread, whatever N is. Workers are pinned
+ * to CPU k (the calling thread is worker 0, pinned to CPU 0), which
+ * makes first-touch NUMA placement stick: first_touch faults each band
+ * of B in on the thread that will later write it.
+ *
+ * link with trans.c and -pthread
+ */
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAXTHREADS 64
+#define BAND_ALIGN 64 // SIMD_BLOCK in trans.c
+
+void transpose_simd_cols(int M, int N, int A[N][M], int B[M][N], int c0, int c1);
+void transpose_parallel(int M, int N, int A[N][M], int B[M][N], int threads);
+void first_touch(int M, int N, int B[M][N], int threads);
+
+#define JOB_TRANSPOSE 0
+#define JOB_TOUCH 1
+
+/*
+ * pool structure description
+ *
+ * Workers 1 .. nthreads-1 sleep on `start` until `generation` moves on,
+ * run their band of the posted job and count `pending` down; the caller
+ * is worker 0 and waits on `done` for the rest.
+ */
+static struct{
+    pthread_t tid[MAXTHREADS];
+    unsigned long seen[MAXTHREADS]; // last generation each worker ran
+    int nthreads;
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    unsigned long generation;
+    int pending;
+
+    /*the posted job*/
+    int kind;
+    int active;         // threads taking part, <= nthreads
+    int M, N;
+    int *A, *B;
+} pool = {.lock = PTHREAD_MUTEX_INITIALIZER, .start = PTHREAD_COND_INITIALIZER, .done = PTHREAD_COND_INITIALIZER};
+
+/*
+ * band - columns of A (rows of B) owned by thread k of `active`
+ */
+static void band(int M, int active, int k, int *c0, int *c1){
+
+    int width = (M + active - 1) / active;
+
+    width = (width + BAND_ALIGN - 1) / BAND_ALIGN * BAND_ALIGN;
+    *c0 = k * width < M ? k * width : M;
+    *c1 = (k + 1) * width < M ? (k + 1) * width : M;
+}
+
+static void run_band(int k){
+
+    int M = pool.M, N = pool.N;
+    int c0, c1;
+
+    band(M, pool.active, k, &c0, &c1);
+    if(c0 == c1){
+        return;
+    }
+    if(pool.kind == JOB_TRANSPOSE){
+        transpose_simd_cols(M, N, (int (*)[M])pool.A, (int (*)[N])pool.B, c0, c1);
+    }
+    else{
+        memset(pool.B + (size_t)c0 * N, 0, sizeof(int) * (size_t)(c1 - c0) * N);
+    }
+}
+
+static void pin(int k){
+
+    cpu_set_t set;
+    long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+
+    CPU_ZERO(&set);
+    CPU_SET(k % (ncpu > 0 ? ncpu : 1), &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+static void *worker(void *arg){
+
+    int k = (int)(long)arg;
+
+    pin(k);
+    for(;;){
+        pthread_mutex_lock(&pool.lock);
+        while(pool.generation == pool.seen[k]){
+            pthread_cond_wait(&pool.start, &pool.lock);
+        }
+        pool.seen[k] = pool.generation;
+        pthread_mutex_unlock(&pool.lock);
+
+        if(k < pool.active){
+            run_band(k);
+        }
+
+        pthread_mutex_lock(&pool.lock);
+        if(--pool.pending == 0){
+            pthread_cond_signal(&pool.done);
+        }
+        pthread_mutex_unlock(&pool.lock);
+    }
+    return NULL;
+}
+
+/*
+ * run_job - post a job to `threads` threads (the pool grows on demand)
+ *     and return once every band is done
+ */
+static void run_job(int kind, int M, int N, int *A, int *B, int threads){
+
+    if(threads < 1){
+        threads = 1;
+    }
+    if(threads > MAXTHREADS){
+        threads = MAXTHREADS;
+    }
+    if(pool.nthreads == 0){ // the caller is worker 0
+        pin(0);
+        pool.nthreads = 1;
+    }
+    while(pool.nthreads < threads){
+        pool.seen[pool.nthreads] = pool.generation; // start with the next job
+        if(pthread_create(&pool.tid[pool.nthreads], NULL, worker, (void *)(long)pool.nthreads) != 0){
+            threads = pool.nthreads;
+            break;
+        }
+        pool.nthreads++;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.kind = kind;
+    pool.active = threads;
+    pool.M = M;
+    pool.N = N;
+    pool.A = A;
+    pool.B = B;
+    pool.pending = pool.nthreads - 1;
+    pool.generation++;
+    pthread_cond_broadcast(&pool.start);
+    pthread_mutex_unlock(&pool.lock);
+
+    run_band(0);
+
+    pthread_mutex_lock(&pool.lock);
+    while(pool.pending > 0){
+        pthread_cond_wait(&pool.done, &pool.lock);
+    }
+    pthread_mutex_unlock(&pool.lock);
+}
+
+/*
+ * transpose_parallel - transpose_simd with each of `threads` threads
+ *     writing its own band of rows of B
+ */
+void transpose_parallel(int M, int N, int A[N][M], int B[M][N], int threads){
+
+    run_job(JOB_TRANSPOSE, M, N, &A[0][0], &B[0][0], threads);
+}
+
+/*
+ * first_touch - zero B band by band on the threads transpose_parallel
+ *     will use, so a fresh (not yet faulted) B is placed on their nodes
+ */
+void first_touch(int M, int N, int B[M][N], int threads){
+
+    run_job(JOB_TOUCH, M, N, NULL, &B[0][0], threads);
+}
@@ -0,0 +1,485 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * trans_suite.c - every transpose registered in trans.c over a grid of
+ *     shapes: simulated misses, wall time and hardware counters, written
+ *     as CSV or JSON and optionally checked against an earlier report
+ *
+ * trans.c is linked twice. The plain copy is timed. The second copy is
+ * built with -fsanitize=kernel-address, which makes the compiler call
+ * __asan_load4 / __asan_store4 ... around every memory access without
+ * linking a sanitizer runtime; the hooks below record the accesses
+ * that fall in A or B, like tracegen does under valgrind, and the
+ * recorded trace is run through cachesim. objcopy prefixes that copy's
+ * symbols with traced_ so the two can coexist.
+ *
+ * build:
+ *     gcc -O2 -march=native -c trans.c -o trans.o
+ *     gcc -O0 -fsanitize=kernel-address --param asan-instrumentation-with-call-threshold=0 \
+ *         --param asan-stack=0 --param asan-globals=0 -c trans.c -o trans_traced.o
+ *     objcopy --prefix-symbols=traced_ trans_traced.o
+ *     gcc -O2 -o trans_suite trans_suite.c trans.o trans_traced.o cachesim.c
+ *
+ * usage: ./trans_suite [-s <s> -E <E> -b <b>] [-r <reps>] [-j] [-o <file>] [-c <baseline.csv>] [<M> <N> ...]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "cachesim.h"
+
+#define MAXFUNCS 32
+#define LAB_ELEMS (256 * 256) // B follows A[256][256] in the driver
+
+typedef void (*trans_fn)(int M, int N, int A[N][M], int B[M][N]);
+
+void registerFunctions(void);
+void traced_registerFunctions(void);
+int is_transpose(int M, int N, int A[N][M], int B[M][N]);
+
+/*the same functions, in registration order, from both copies of trans.c*/
+trans_fn funcs[MAXFUNCS];
+trans_fn traced[MAXFUNCS];
+char *descs[MAXFUNCS];
+int nfuncs, ntraced;
+
+void registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]), char *desc){
+
+    if(nfuncs < MAXFUNCS){
+        funcs[nfuncs] = trans;
+        descs[nfuncs] = desc;
+        nfuncs++;
+    }
+}
+
+void traced_registerTransFunction(void (*trans)(int M, int N, int[N][M], int[M][N]), char *desc){
+
+    (void)desc;
+    if(ntraced < MAXFUNCS){
+        traced[ntraced++] = trans;
+    }
+}
+
+/*
+ * access recording: only between trace_begin and trace_end, and only
+ * inside [lo, hi) (A and B), so stack spills at -O0 are left out as
+ * tracegen leaves them out
+ */
+bool recording;
+uintptr_t lo, hi;
+unsigned long long int *addrs;
+char *ops;
+int *sizes;
+size_t n_access, cap_access;
+
+static void record(char op, uintptr_t address, size_t size){
+
+    if(!recording || address < lo || address >= hi){
+        return;
+    }
+    if(n_access == cap_access){
+        cap_access = cap_access ? cap_access * 2 : 1 << 16;
+        addrs = realloc(addrs, sizeof(unsigned long long int) * cap_access);
+        ops = realloc(ops, cap_access);
+        sizes = realloc(sizes, sizeof(int) * cap_access);
+        if(addrs == NULL || ops == NULL || sizes == NULL){
+            fprintf(stderr, "trace allocation failed\n");
+            exit(1);
+        }
+    }
+    addrs[n_access] = address;
+    ops[n_access] = op;
+    sizes[n_access] = (int)size;
+    n_access++;
+}
+
+#define HOOKS(SIZE)                                                                             \
+void traced___asan_load##SIZE##_noabort(uintptr_t address) { record('L', address, SIZE); }      \
+void traced___asan_store##SIZE##_noabort(uintptr_t address) { record('S', address, SIZE); }
+
+HOOKS(1)
+HOOKS(2)
+HOOKS(4)
+HOOKS(8)
+HOOKS(16)
+
+void traced___asan_loadN_noabort(uintptr_t address, size_t size){
+    record('L', address, size);
+}
+
+void traced___asan_storeN_noabort(uintptr_t address, size_t size){
+    record('S', address, size);
+}
+
+/*hardware counters, one group led by cycles*/
+#define NCOUNTERS 5
+const char *counter_names[NCOUNTERS] = {"cycles", "instructions", "cache_refs", "cache_misses", "l1d_misses"};
+const struct{
+    uint32_t type;
+    uint64_t config;
+} counter_events[NCOUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+int counter_fd[NCOUNTERS];
+
+/*
+ * counters_open - open what the kernel allows; a counter that cannot be
+ *     opened (no PMU, perf_event_paranoid, containers) reads as -1
+ */
+static void counters_open(void){
+
+    int leader = -1;
+
+    for(int k = 0; k < NCOUNTERS; k++){
+        struct perf_event_attr attr;
+
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = counter_events[k].type;
+        attr.config = counter_events[k].config;
+        attr.disabled = leader == -1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        counter_fd[k] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        if(leader == -1 && counter_fd[k] >= 0){
+            leader = counter_fd[k];
+        }
+    }
+}
+
+static void counters_start(void){
+
+    for(int k = 0; k < NCOUNTERS; k++){
+        if(counter_fd[k] >= 0){
+            ioctl(counter_fd[k], PERF_EVENT_IOC_RESET, 0);
+            ioctl(counter_fd[k], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+static void counters_stop(long long *values){
+
+    for(int k = 0; k < NCOUNTERS; k++){
+        values[k] = -1;
+        if(counter_fd[k] >= 0){
+            ioctl(counter_fd[k], PERF_EVENT_IOC_DISABLE, 0);
+            if(read(counter_fd[k], &values[k], sizeof(values[k])) != sizeof(values[k])){
+                values[k] = -1;
+            }
+        }
+    }
+}
+
+typedef struct{
+    int f, M, N;
+    unsigned long long int hits, misses, evictions;
+    double ms;
+    long long counters[NCOUNTERS];
+    bool correct;
+} result;
+
+result *results;
+int nresults, cap_results;
+csim_config cfg;
+int reps = 5;
+
+static double now(void){
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * run - one function on one shape: traced once for the misses, then
+ *     timed (best of reps, counters of the best run)
+ */
+static void run(int f, int M, int N, int *A, int *B){
+
+    result r = {.f = f, .M = M, .N = N, .ms = 1e30};
+    cache_sim *sim = csim_create(&cfg);
+    csim_stats st;
+
+    if(sim == NULL){
+        fprintf(stderr, "cache allocation failed\n");
+        exit(1);
+    }
+    n_access = 0;
+    recording = true;
+    traced[f](M, N, (int (*)[M])A, (int (*)[N])B);
+    recording = false;
+    if(csim_access_batch(sim, addrs, ops, sizes, 0, n_access) != 0){
+        fprintf(stderr, "cache simulator ran out of memory\n");
+        exit(1);
+    }
+    csim_snapshot(sim, &st);
+    csim_free(sim);
+    r.hits = st.hits;
+    r.misses = st.misses;
+    r.evictions = st.evictions;
+
+    for(int k = 0; k < reps; k++){
+        long long values[NCOUNTERS];
+        double start = now();
+        double elapsed;
+
+        counters_start();
+        funcs[f](M, N, (int (*)[M])A, (int (*)[N])B);
+        counters_stop(values);
+        elapsed = (now() - start) * 1e3;
+        if(elapsed < r.ms){
+            r.ms = elapsed;
+            memcpy(r.counters, values, sizeof(values));
+        }
+    }
+    r.correct = is_transpose(M, N, (int (*)[M])A, (int (*)[N])B);
+
+    if(nresults == cap_results){
+        cap_results = cap_results ? cap_results * 2 : 64;
+        results = realloc(results, sizeof(result) * cap_results);
+        if(results == NULL){
+            fprintf(stderr, "allocation failed\n");
+            exit(1);
+        }
+    }
+    results[nresults++] = r;
+}
+
+/*
+ * shape - every function on M x N; A and B sit as in the driver, B
+ *     LAB_ELEMS ints after A (or right after A when A is larger)
+ */
+static void shape(int M, int N){
+
+    size_t elems = (size_t)M * N > LAB_ELEMS ? (size_t)M * N : LAB_ELEMS;
+    // aligned_alloc wants a multiple of the alignment
+    int *A = aligned_alloc(4096, (sizeof(int) * elems * 2 + 4095) & ~(size_t)4095);
+    int *B = A + elems;
+
+    if(A == NULL){
+        fprintf(stderr, "%dx%d: allocation failed\n", M, N);
+        return;
+    }
+    for(size_t i = 0; i < elems * 2; i++){
+        A[i] = (int)(i * 2654435761u);
+    }
+    lo = (uintptr_t)A;
+    hi = (uintptr_t)(B + elems);
+
+    for(int f = 0; f < nfuncs; f++){
+        memset(B, 0, sizeof(int) * elems);
+        run(f, M, N, A, B);
+    }
+    free(A);
+}
+
+static void write_csv(FILE *out){
+
+    fprintf(out, "function,M,N,hits,misses,evictions,time_ms");
+    for(int k = 0; k < NCOUNTERS; k++){
+        fprintf(out, ",%s", counter_names[k]);
+    }
+    fprintf(out, ",correct\n");
+    for(int i = 0; i < nresults; i++){
+        result *r = &results[i];
+
+        fprintf(out, "\"%s\",%d,%d,%llu,%llu,%llu,%.4f", descs[r->f], r->M, r->N, r->hits, r->misses,
+                r->evictions, r->ms);
+        for(int k = 0; k < NCOUNTERS; k++){
+            fprintf(out, ",%lld", r->counters[k]);
+        }
+        fprintf(out, ",%d\n", r->correct);
+    }
+}
+
+static void write_json(FILE *out){
+
+    fprintf(out, "{\"cache\": {\"s\": %d, \"E\": %d, \"b\": %d}, \"results\": [\n", cfg.s, cfg.E, cfg.b);
+    for(int i = 0; i < nresults; i++){
+        result *r = &results[i];
+
+        fprintf(out, "  {\"function\": \"%s\", \"M\": %d, \"N\": %d, \"hits\": %llu, \"misses\": %llu, "
+                "\"evictions\": %llu, \"time_ms\": %.4f", descs[r->f], r->M, r->N, r->hits, r->misses,
+                r->evictions, r->ms);
+        for(int k = 0; k < NCOUNTERS; k++){
+            if(r->counters[k] >= 0){
+                fprintf(out, ", \"%s\": %lld", counter_names[k], r->counters[k]);
+            }
+            else{
+                fprintf(out, ", \"%s\": null", counter_names[k]);
+            }
+        }
+        fprintf(out, ", \"correct\": %s}%s\n", r->correct ? "true" : "false", i + 1 < nresults ? "," : "");
+    }
+    fprintf(out, "]}\n");
+}
+
+/*
+ * compare - misses against an earlier CSV report; returns the number of
+ *     (function, shape) pairs that now miss more, or are no longer correct
+ */
+static int compare(const char *path){
+
+    FILE *in = fopen(path, "r");
+    char line[512];
+    int regressions = 0;
+
+    if(in == NULL){
+        fprintf(stderr, "%s: No such file\n", path);
+        return 1;
+    }
+    while(fgets(line, sizeof(line), in) != NULL){
+        char *end = strchr(line + 1, '"');
+        int M, N;
+        unsigned long long int hits, misses;
+
+        if(line[0] != '"' || end == NULL){
+            continue;
+        }
+        *end = '\0';
+        if(sscanf(end + 1, ",%d,%d,%llu,%llu", &M, &N, &hits, &misses) != 4){
+            continue;
+        }
+        for(int i = 0; i < nresults; i++){
+            result *r = &results[i];
+
+            if(r->M != M || r->N != N || strcmp(descs[r->f], line + 1)){
+                continue;
+            }
+            if(r->misses > misses || !r->correct){
+                fprintf(stderr, "REGRESSION %s %dx%d: misses %llu -> %llu%s\n", descs[r->f], M, N,
+                        misses, r->misses, r->correct ? "" : ", wrong result");
+                regressions++;
+            }
+        }
+    }
+    fclose(in);
+    return regressions;
+}
+
+/*default grid: the graded shapes, powers of two and ragged ones*/
+int grid[][2] = {{32, 32}, {64, 64}, {61, 67}, {48, 48}, {96, 80}, {128, 128}, {100, 200}, {256, 256}, {1024, 1024}};
+#define NGRID (int)(sizeof(grid) / sizeof(grid[0]))
+
+static void usage(void){
+    printf("Usage: ./trans_suite [-s <s> -E <E> -b <b>] [-r <reps>] [-j] [-o <file>] [-c <baseline.csv>] [<M> <N> ...]\n");
+    printf("  -s -E -b  cache geometry for the miss counts (default 5 1 5: the 1KB lab cache)\n");
+    printf("  -r  timed runs per function and shape, best kept (default 5)\n");
+    printf("  -j  write JSON instead of CSV\n");
+    printf("  -o  write the report to <file> instead of stdout\n");
+    printf("  -c  exit 1 if any function misses more than in this earlier CSV report\n");
+}
+
+int main(int argc, char *argv[])
+{
+
+    int opt;
+    bool json = false;
+    const char *out_path = NULL;
+    const char *baseline = NULL;
+    const char *err;
+    FILE *out = stdout;
+    int regressions = 0;
+
+    csim_default_config(&cfg);
+    cfg.s = 5;
+    cfg.E = 1;
+    cfg.b = 5;
+
+    while((opt = getopt(argc, argv, "hs:E:b:r:jo:c:")) != -1){
+        switch(opt){
+            case 's':
+            cfg.s = atoi(optarg);
+            break;
+            case 'E':
+            cfg.E = atoi(optarg);
+            break;
+            case 'b':
+            cfg.b = atoi(optarg);
+            break;
+            case 'r':
+            reps = atoi(optarg);
+            break;
+            case 'j':
+            json = true;
+            break;
+            case 'o':
+            out_path = optarg;
+            break;
+            case 'c':
+            baseline = optarg;
+            break;
+            case 'h':
+            usage();
+            return 0;
+            default:
+            usage();
+            return 1;
+        }
+    }
+    if(reps < 1 || (argc - optind) % 2){
+        usage();
+        return 1;
+    }
+    err = csim_check_config(&cfg);
+    if(err != NULL){
+        printf("%s\n", err);
+        return 1;
+    }
+
+    registerFunctions();
+    traced_registerFunctions();
+    if(nfuncs != ntraced){
+        fprintf(stderr, "trans.o and trans_traced.o register different functions\n");
+        return 1;
+    }
+    counters_open();
+
+    if(optind == argc){
+        for(int k = 0; k < NGRID; k++){
+            shape(grid[k][0], grid[k][1]);
+        }
+    }
+    for(int k = optind; k + 1 < argc; k += 2){
+        shape(atoi(argv[k]), atoi(argv[k + 1]));
+    }
+
+    if(out_path != NULL){
+        out = fopen(out_path, "w");
+        if(out == NULL){
+            fprintf(stderr, "%s: cannot write\n", out_path);
+            return 1;
+        }
+    }
+    if(json){
+        write_json(out);
+    }
+    else{
+        write_csv(out);
+    }
+    if(out != stdout){
+        fclose(out);
+    }
+
+    if(baseline != NULL){
+        regressions = compare(baseline);
+    }
+
+    free(results);
+    free(addrs);
+    free(ops);
+    free(sizes);
+    return regressions ? 1 : 0;
+}
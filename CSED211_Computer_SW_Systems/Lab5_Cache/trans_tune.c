@@ -0,0 +1,405 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * trans_tune.c - pick a transpose tiling for one M x N shape by
+ *     simulating the misses of every candidate with the cachesim library
+ *
+ * The candidates are the schemes trans.c uses, with their sizes left
+ * open: th x tw tiles, th and tw each a power of two from 1 to 32,
+ * walked row- or column-major, with or without the diagonal element
+ * deferred, and the 64x64 split scheme on 4x4 and 8x8 tiles. Each one's
+ * A/B access stream is generated directly (as tracegen would record it)
+ * and run through a fresh cache_sim. The best is printed, and with -e
+ * emitted as a trans.c function.
+ *
+ * build: gcc -O2 -o trans_tune trans_tune.c cachesim.c
+ * usage: ./trans_tune -M <M> -N <N> [-s <s> -E <E> -b <b>] [-o <B offset>] [-n <N>] [-e]
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <getopt.h>
+#include "cachesim.h"
+
+#define A_BASE 0x10000000ULL       // page aligned, like the driver's static arrays
+#define LAB_OFFSET (256 * 256 * 4) // B follows A[256][256] in tracegen
+
+#define KIND_TILE 0
+#define KIND_SPLIT 1
+
+typedef struct{
+    int kind;
+    int th, tw;         // tile rows (of A) and columns; split: th == tw
+    bool col_major;     // tiles walked down columns of A first
+    bool diag;          // diagonal element copied after its row
+    unsigned long long int misses;
+} tiling;
+
+int M, N;
+unsigned long long int b_base;
+
+/*access stream of the candidate being scored*/
+unsigned long long int *addrs;
+char *ops;
+size_t n_access, cap_access;
+
+static void touch(char op, unsigned long long int address){
+
+    if(n_access == cap_access){
+        cap_access = cap_access ? cap_access * 2 : 1 << 16;
+        addrs = realloc(addrs, sizeof(unsigned long long int) * cap_access);
+        ops = realloc(ops, cap_access);
+        if(addrs == NULL || ops == NULL){
+            printf("trace allocation failed\n");
+            exit(1);
+        }
+    }
+    addrs[n_access] = address;
+    ops[n_access] = op;
+    n_access++;
+}
+
+static void read_a(int i, int j){
+
+    touch('L', A_BASE + ((unsigned long long int)i * M + j) * sizeof(int));
+}
+
+static void b_at(char op, int j, int i){
+
+    touch(op, b_base + ((unsigned long long int)j * N + i) * sizeof(int));
+}
+
+/*
+ * trace_tile - rows r0..r1-1, columns c0..c1-1, as transpose_tile does it
+ *     (or plainly, without the diagonal trick)
+ */
+static void trace_tile(bool diag, int r0, int r1, int c0, int c1){
+
+    for(int il = r0; il < r1; il++){
+        for(int jl = c0; jl < c1; jl++){
+            read_a(il, jl);
+            if(!diag || jl != il){
+                b_at('S', jl, il);
+            }
+        }
+        if(diag && il >= c0 && il < c1){
+            b_at('S', il, il);
+        }
+    }
+}
+
+/*
+ * trace_split - transpose_split on a 2h x 2h tile at (i, j)
+ */
+static void trace_split(int h, int i, int j){
+
+    for(int il = i; il < i + h; il++){
+        for(int k = 0; k < 2 * h; k++){
+            read_a(il, j + k);
+        }
+        for(int k = 0; k < h; k++){
+            b_at('S', j + k, il);
+        }
+        for(int k = 0; k < h; k++){
+            b_at('S', j + k, il + h);
+        }
+    }
+    for(int jl = j; jl < j + h; jl++){
+        for(int k = 0; k < h; k++){
+            read_a(i + h + k, jl);
+        }
+        for(int k = 0; k < h; k++){
+            b_at('L', jl, i + h + k);
+        }
+        for(int k = 0; k < h; k++){
+            b_at('S', jl, i + h + k);
+        }
+        for(int k = 0; k < h; k++){
+            b_at('S', jl + h, i + k);
+        }
+    }
+    for(int il = i; il < i + h; il++){
+        for(int k = 0; k < h; k++){
+            read_a(il + h, j + h + k);
+        }
+        for(int k = 0; k < h; k++){
+            b_at('S', j + h + k, il + h);
+        }
+    }
+}
+
+/*
+ * trace - the whole access stream of one candidate
+ */
+static void trace(const tiling *t){
+
+    int outer = t->col_major ? M : N;
+    int inner = t->col_major ? N : M;
+    int step_outer = t->col_major ? t->tw : t->th;
+    int step_inner = t->col_major ? t->th : t->tw;
+
+    n_access = 0;
+    for(int x = 0; x < outer; x += step_outer){
+        for(int y = 0; y < inner; y += step_inner){
+            int i = t->col_major ? y : x;
+            int j = t->col_major ? x : y;
+            int r1 = i + t->th < N ? i + t->th : N;
+            int c1 = j + t->tw < M ? j + t->tw : M;
+
+            if(t->kind == KIND_TILE){
+                trace_tile(t->diag, i, r1, j, c1);
+            }
+            else if(i + t->th <= N && j + t->tw <= M){
+                trace_split(t->th / 2, i, j);
+            }
+            else{ // edge tiles half as tall, as in transpose_blocked
+                for(int il = i; il < r1; il += t->th / 2){
+                    trace_tile(true, il, il + t->th / 2 < r1 ? il + t->th / 2 : r1, j, c1);
+                }
+            }
+        }
+    }
+}
+
+static unsigned long long int score(const csim_config *cfg, tiling *t){
+
+    cache_sim *sim = csim_create(cfg);
+    csim_stats st;
+
+    if(sim == NULL){
+        printf("cache allocation failed\n");
+        exit(1);
+    }
+    trace(t);
+    if(csim_access_batch(sim, addrs, ops, NULL, sizeof(int), n_access) != 0){
+        printf("cache simulator ran out of memory\n");
+        exit(1);
+    }
+    csim_snapshot(sim, &st);
+    csim_free(sim);
+
+    t->misses = st.misses;
+    return st.misses;
+}
+
+static void describe(const tiling *t, char *buf, size_t len){
+
+    if(t->kind == KIND_SPLIT){
+        snprintf(buf, len, "%dx%d split tiles (4 quarters), %s", t->th, t->tw,
+                 t->col_major ? "column-major" : "row-major");
+    }
+    else{
+        snprintf(buf, len, "%dx%d tiles, %s%s", t->th, t->tw, t->col_major ? "column-major" : "row-major",
+                 t->diag ? ", diagonal deferred" : "");
+    }
+}
+
+static int by_misses(const void *x, const void *y){
+
+    const tiling *p = x;
+    const tiling *q = y;
+
+    return (p->misses > q->misses) - (p->misses < q->misses);
+}
+
+/*
+ * emit_split - unrolled transpose_split for half size h (temporaries
+ *     tmp0 .. tmp(2h-1), so h <= 4 keeps within the 12-variable rule)
+ */
+static void emit_split(int h){
+
+    printf("            if (i + %d <= N && j + %d <= M)\n            {\n", 2 * h, 2 * h);
+    printf("                for (il = i; il < i + %d; il++)\n                {\n", h);
+    for(int k = 0; k < 2 * h; k++){
+        printf("                    tmp%d = A[il][j + %d];\n", k, k);
+    }
+    for(int k = 0; k < h; k++){
+        printf("                    B[j + %d][il] = tmp%d;\n", k, k);
+    }
+    for(int k = 0; k < h; k++){
+        printf("                    B[j + %d][il + %d] = tmp%d;\n", k, h, h + k);
+    }
+    printf("                }\n");
+    printf("                for (jl = j; jl < j + %d; jl++)\n                {\n", h);
+    for(int k = 0; k < h; k++){
+        printf("                    tmp%d = A[i + %d][jl];\n", h + k, h + k);
+    }
+    for(int k = 0; k < h; k++){
+        printf("                    tmp%d = B[jl][i + %d];\n", k, h + k);
+    }
+    for(int k = 0; k < h; k++){
+        printf("                    B[jl][i + %d] = tmp%d;\n", h + k, h + k);
+    }
+    for(int k = 0; k < h; k++){
+        printf("                    B[jl + %d][i + %d] = tmp%d;\n", h, k, k);
+    }
+    printf("                }\n");
+    printf("                for (il = i; il < i + %d; il++)\n                {\n", h);
+    for(int k = 0; k < h; k++){
+        printf("                    tmp%d = A[il + %d][j + %d];\n", k, h, h + k);
+    }
+    for(int k = 0; k < h; k++){
+        printf("                    B[j + %d][il + %d] = tmp%d;\n", h + k, h, k);
+    }
+    printf("                }\n                continue;\n            }\n");
+}
+
+/*
+ * emit - the winning tiling as a function to paste into trans.c; at most
+ *     12 int locals: i, j, il, jl and temp, or for the split kind the 8
+ *     temporaries, tmp0 doubling as temp in the edge tiles
+ */
+static void emit(const tiling *t){
+
+    char desc[128];
+    bool split = t->kind == KIND_SPLIT;
+    const char *temp = split ? "tmp0" : "temp";
+
+    describe(t, desc, sizeof(desc));
+    printf("\nchar transpose_%dx%d_desc[] = \"Tuned %dx%d: %s\";\n", M, N, M, N, desc);
+    printf("void transpose_%dx%d(int M, int N, int A[N][M], int B[M][N])\n{\n", M, N);
+    printf("    int i, j, il, jl%s;\n", t->diag && !split ? ", temp = 0" : "");
+    if(split){
+        printf("    int tmp0 = 0");
+        for(int k = 1; k < t->th; k++){
+            printf(", tmp%d", k);
+        }
+        printf(";\n");
+    }
+    printf("\n");
+    if(t->col_major){
+        printf("    for (j = 0; j < M; j += %d)\n    {\n        for (i = 0; i < N; i += %d)\n        {\n", t->tw, t->th);
+    }
+    else{
+        printf("    for (i = 0; i < N; i += %d)\n    {\n        for (j = 0; j < M; j += %d)\n        {\n", t->th, t->tw);
+    }
+    if(split){
+        emit_split(t->th / 2);
+    }
+    // the split kind's half-height edge tiles run through the same rows in the same order
+    printf("            for (il = i; il < N && il < i + %d; il++)\n            {\n", t->th);
+    printf("                for (jl = j; jl < M && jl < j + %d; jl++)\n                {\n", t->tw);
+    if(t->diag || split){
+        printf("                    if (jl == il)\n                    {\n");
+        printf("                        %s = A[il][jl];\n                    }\n", temp);
+        printf("                    if (jl != il)\n                    {\n");
+        printf("                        B[jl][il] = A[il][jl];\n                    }\n");
+        printf("                }\n");
+        printf("                if (il >= j && il < j + %d && il < M)\n                {\n", t->tw);
+        printf("                    B[il][il] = %s;\n                }\n", temp);
+    }
+    else{
+        printf("                    B[jl][il] = A[il][jl];\n                }\n");
+    }
+    printf("            }\n        }\n    }\n}\n");
+}
+
+static void usage(void){
+    printf("Usage: ./trans_tune -M <M> -N <N> [-s <s> -E <E> -b <b>] [-o <B offset>] [-n <N>] [-e]\n");
+    printf("  -s -E -b  cache geometry as in csim (default 5 1 5: the 1KB lab cache)\n");
+    printf("  -o  bytes from A to B (default %d, the driver's layout)\n", LAB_OFFSET);
+    printf("  -n  candidates listed (default 10)\n");
+    printf("  -e  print the best tiling as a trans.c function\n");
+}
+
+int main(int argc, char *argv[])
+{
+
+    int opt;
+    csim_config cfg;
+    const char *err;
+    unsigned long long int offset = LAB_OFFSET;
+    int top_n = 10;
+    bool do_emit = false;
+    tiling *cand;
+    int ncand = 0;
+    char desc[128];
+    static const int sizes[] = {1, 2, 4, 8, 16, 32};
+    int nsizes = (int)(sizeof(sizes) / sizeof(sizes[0]));
+
+    csim_default_config(&cfg);
+    cfg.s = 5;
+    cfg.E = 1;
+    cfg.b = 5;
+
+    while((opt = getopt(argc, argv, "hM:N:s:E:b:o:n:e")) != -1){
+        switch(opt){
+            case 'M':
+            M = atoi(optarg);
+            break;
+            case 'N':
+            N = atoi(optarg);
+            break;
+            case 's':
+            cfg.s = atoi(optarg);
+            break;
+            case 'E':
+            cfg.E = atoi(optarg);
+            break;
+            case 'b':
+            cfg.b = atoi(optarg);
+            break;
+            case 'o':
+            offset = strtoull(optarg, NULL, 0);
+            break;
+            case 'n':
+            top_n = atoi(optarg);
+            break;
+            case 'e':
+            do_emit = true;
+            break;
+            case 'h':
+            usage();
+            return 0;
+            default:
+            usage();
+            return 1;
+        }
+    }
+    if(M <= 0 || N <= 0 || top_n < 0){
+        usage();
+        return 1;
+    }
+    err = csim_check_config(&cfg);
+    if(err != NULL){
+        printf("%s\n", err);
+        return 1;
+    }
+    b_base = A_BASE + offset;
+
+    cand = malloc(sizeof(tiling) * (nsizes * nsizes * 4 + 4));
+    if(cand == NULL){
+        printf("allocation failed\n");
+        return 1;
+    }
+    for(int x = 0; x < nsizes; x++){
+        for(int y = 0; y < nsizes; y++){
+            for(int order = 0; order < 2; order++){
+                for(int diag = 0; diag < 2; diag++){
+                    cand[ncand++] = (tiling){KIND_TILE, sizes[x], sizes[y], order, diag, 0};
+                }
+            }
+        }
+    }
+    cand[ncand++] = (tiling){KIND_SPLIT, 4, 4, false, true, 0};
+    cand[ncand++] = (tiling){KIND_SPLIT, 8, 8, false, true, 0};
+
+    for(int k = 0; k < ncand; k++){
+        score(&cfg, &cand[k]);
+    }
+    qsort(cand, ncand, sizeof(tiling), by_misses);
+
+    printf("%dx%d on s=%d E=%d b=%d, %zu accesses per candidate\n", M, N, cfg.s, cfg.E, cfg.b, n_access);
+    for(int k = 0; k < ncand && k < top_n; k++){
+        describe(&cand[k], desc, sizeof(desc));
+        printf("%8llu misses  %s\n", cand[k].misses, desc);
+    }
+    if(do_emit){
+        emit(&cand[0]);
+    }
+
+    free(cand);
+    free(addrs);
+    free(ops);
+    return 0;
+}
@@ -0,0 +1,219 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * trans_typed.c - int8, int16, int32, int64, float, double and pair32
+ *     transposes, each with the register kernel for its element size
+ *     (see trans_typed.h)
+ *
+ * Kernels move bits, not values, so one kernel serves every type of its
+ * size: 32-bit 8x8 (AVX2) or 4x4 (SSE2), 64-bit 4x4 (AVX) or 2x2 (SSE2),
+ * 16-bit 8x8 and 8-bit 16x16 (SSE2). Without SSE2 every type is scalar
+ * only.
+ */
+#include "trans_typed.h"
+#if defined(__AVX2__) || defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#if defined(__SSE2__)
+/*
+ * kernel8 - 16x16 8-bit tile: four rounds of interleaving row k with row
+ *     k + 8. Each round rotates the 8-bit (row, column) index left by one
+ *     bit, so after four the row and column halves have swapped.
+ */
+static inline void kernel8(const char *a, size_t lda, char *b, size_t ldb)
+{
+    __m128i r[16], t[16];
+
+    for (int k = 0; k < 16; k++)
+        r[k] = _mm_loadu_si128((const __m128i *)(a + k * lda));
+    for (int round = 0; round < 4; round++)
+    {
+        for (int k = 0; k < 8; k++)
+        {
+            t[2 * k] = _mm_unpacklo_epi8(r[k], r[k + 8]);
+            t[2 * k + 1] = _mm_unpackhi_epi8(r[k], r[k + 8]);
+        }
+        for (int k = 0; k < 16; k++)
+            r[k] = t[k];
+    }
+    for (int k = 0; k < 16; k++)
+        _mm_storeu_si128((__m128i *)(b + k * ldb), r[k]);
+}
+#define KERNEL8 kernel8
+#define KTILE8 16
+
+/*
+ * kernel16 - 8x8 16-bit tile: three rounds of unpacks, pairing words,
+ *     then dwords, then qwords
+ */
+static inline void kernel16(const char *a, size_t lda, char *b, size_t ldb)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(a));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(a + lda));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(a + 2 * lda));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(a + 3 * lda));
+    __m128i r4 = _mm_loadu_si128((const __m128i *)(a + 4 * lda));
+    __m128i r5 = _mm_loadu_si128((const __m128i *)(a + 5 * lda));
+    __m128i r6 = _mm_loadu_si128((const __m128i *)(a + 6 * lda));
+    __m128i r7 = _mm_loadu_si128((const __m128i *)(a + 7 * lda));
+
+    __m128i t0 = _mm_unpacklo_epi16(r0, r1);
+    __m128i t1 = _mm_unpackhi_epi16(r0, r1);
+    __m128i t2 = _mm_unpacklo_epi16(r2, r3);
+    __m128i t3 = _mm_unpackhi_epi16(r2, r3);
+    __m128i t4 = _mm_unpacklo_epi16(r4, r5);
+    __m128i t5 = _mm_unpackhi_epi16(r4, r5);
+    __m128i t6 = _mm_unpacklo_epi16(r6, r7);
+    __m128i t7 = _mm_unpackhi_epi16(r6, r7);
+
+    r0 = _mm_unpacklo_epi32(t0, t2);
+    r1 = _mm_unpackhi_epi32(t0, t2);
+    r2 = _mm_unpacklo_epi32(t1, t3);
+    r3 = _mm_unpackhi_epi32(t1, t3);
+    r4 = _mm_unpacklo_epi32(t4, t6);
+    r5 = _mm_unpackhi_epi32(t4, t6);
+    r6 = _mm_unpacklo_epi32(t5, t7);
+    r7 = _mm_unpackhi_epi32(t5, t7);
+
+    _mm_storeu_si128((__m128i *)(b), _mm_unpacklo_epi64(r0, r4));
+    _mm_storeu_si128((__m128i *)(b + ldb), _mm_unpackhi_epi64(r0, r4));
+    _mm_storeu_si128((__m128i *)(b + 2 * ldb), _mm_unpacklo_epi64(r1, r5));
+    _mm_storeu_si128((__m128i *)(b + 3 * ldb), _mm_unpackhi_epi64(r1, r5));
+    _mm_storeu_si128((__m128i *)(b + 4 * ldb), _mm_unpacklo_epi64(r2, r6));
+    _mm_storeu_si128((__m128i *)(b + 5 * ldb), _mm_unpackhi_epi64(r2, r6));
+    _mm_storeu_si128((__m128i *)(b + 6 * ldb), _mm_unpacklo_epi64(r3, r7));
+    _mm_storeu_si128((__m128i *)(b + 7 * ldb), _mm_unpackhi_epi64(r3, r7));
+}
+#define KERNEL16 kernel16
+#define KTILE16 8
+#else
+#define KERNEL8 NO_KERNEL
+#define KTILE8 0
+#define KERNEL16 NO_KERNEL
+#define KTILE16 0
+#endif
+
+#if defined(__AVX2__)
+/*
+ * kernel32 - 8x8 32-bit tile, as transpose_kernel in trans.c
+ */
+static inline void kernel32(const char *a, size_t lda, char *b, size_t ldb)
+{
+    __m256i r0 = _mm256_loadu_si256((const __m256i *)(a));
+    __m256i r1 = _mm256_loadu_si256((const __m256i *)(a + lda));
+    __m256i r2 = _mm256_loadu_si256((const __m256i *)(a + 2 * lda));
+    __m256i r3 = _mm256_loadu_si256((const __m256i *)(a + 3 * lda));
+    __m256i r4 = _mm256_loadu_si256((const __m256i *)(a + 4 * lda));
+    __m256i r5 = _mm256_loadu_si256((const __m256i *)(a + 5 * lda));
+    __m256i r6 = _mm256_loadu_si256((const __m256i *)(a + 6 * lda));
+    __m256i r7 = _mm256_loadu_si256((const __m256i *)(a + 7 * lda));
+
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+    __m256i t1 = _mm256_unpackhi_epi32(r0, r1);
+    __m256i t2 = _mm256_unpacklo_epi32(r2, r3);
+    __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i t4 = _mm256_unpacklo_epi32(r4, r5);
+    __m256i t5 = _mm256_unpackhi_epi32(r4, r5);
+    __m256i t6 = _mm256_unpacklo_epi32(r6, r7);
+    __m256i t7 = _mm256_unpackhi_epi32(r6, r7);
+
+    r0 = _mm256_unpacklo_epi64(t0, t2);
+    r1 = _mm256_unpackhi_epi64(t0, t2);
+    r2 = _mm256_unpacklo_epi64(t1, t3);
+    r3 = _mm256_unpackhi_epi64(t1, t3);
+    r4 = _mm256_unpacklo_epi64(t4, t6);
+    r5 = _mm256_unpackhi_epi64(t4, t6);
+    r6 = _mm256_unpacklo_epi64(t5, t7);
+    r7 = _mm256_unpackhi_epi64(t5, t7);
+
+    _mm256_storeu_si256((__m256i *)(b), _mm256_permute2x128_si256(r0, r4, 0x20));
+    _mm256_storeu_si256((__m256i *)(b + ldb), _mm256_permute2x128_si256(r1, r5, 0x20));
+    _mm256_storeu_si256((__m256i *)(b + 2 * ldb), _mm256_permute2x128_si256(r2, r6, 0x20));
+    _mm256_storeu_si256((__m256i *)(b + 3 * ldb), _mm256_permute2x128_si256(r3, r7, 0x20));
+    _mm256_storeu_si256((__m256i *)(b + 4 * ldb), _mm256_permute2x128_si256(r0, r4, 0x31));
+    _mm256_storeu_si256((__m256i *)(b + 5 * ldb), _mm256_permute2x128_si256(r1, r5, 0x31));
+    _mm256_storeu_si256((__m256i *)(b + 6 * ldb), _mm256_permute2x128_si256(r2, r6, 0x31));
+    _mm256_storeu_si256((__m256i *)(b + 7 * ldb), _mm256_permute2x128_si256(r3, r7, 0x31));
+}
+#define KERNEL32 kernel32
+#define KTILE32 8
+#elif defined(__SSE2__)
+/*
+ * kernel32 - 4x4 32-bit tile
+ */
+static inline void kernel32(const char *a, size_t lda, char *b, size_t ldb)
+{
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(a));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(a + lda));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(a + 2 * lda));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(a + 3 * lda));
+
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t2 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+    _mm_storeu_si128((__m128i *)(b), _mm_unpacklo_epi64(t0, t2));
+    _mm_storeu_si128((__m128i *)(b + ldb), _mm_unpackhi_epi64(t0, t2));
+    _mm_storeu_si128((__m128i *)(b + 2 * ldb), _mm_unpacklo_epi64(t1, t3));
+    _mm_storeu_si128((__m128i *)(b + 3 * ldb), _mm_unpackhi_epi64(t1, t3));
+}
+#define KERNEL32 kernel32
+#define KTILE32 4
+#else
+#define KERNEL32 NO_KERNEL
+#define KTILE32 0
+#endif
+
+#if defined(__AVX__)
+/*
+ * kernel64 - 4x4 64-bit tile: unpacks pair rows inside each 128-bit
+ *     lane, the permutes swap the off-diagonal 2x2 quarters
+ */
+static inline void kernel64(const char *a, size_t lda, char *b, size_t ldb)
+{
+    __m256d r0 = _mm256_loadu_pd((const double *)(a));
+    __m256d r1 = _mm256_loadu_pd((const double *)(a + lda));
+    __m256d r2 = _mm256_loadu_pd((const double *)(a + 2 * lda));
+    __m256d r3 = _mm256_loadu_pd((const double *)(a + 3 * lda));
+
+    __m256d t0 = _mm256_unpacklo_pd(r0, r1);
+    __m256d t1 = _mm256_unpackhi_pd(r0, r1);
+    __m256d t2 = _mm256_unpacklo_pd(r2, r3);
+    __m256d t3 = _mm256_unpackhi_pd(r2, r3);
+
+    _mm256_storeu_pd((double *)(b), _mm256_permute2f128_pd(t0, t2, 0x20));
+    _mm256_storeu_pd((double *)(b + ldb), _mm256_permute2f128_pd(t1, t3, 0x20));
+    _mm256_storeu_pd((double *)(b + 2 * ldb), _mm256_permute2f128_pd(t0, t2, 0x31));
+    _mm256_storeu_pd((double *)(b + 3 * ldb), _mm256_permute2f128_pd(t1, t3, 0x31));
+}
+#define KERNEL64 kernel64
+#define KTILE64 4
+#elif defined(__SSE2__)
+/*
+ * kernel64 - 2x2 64-bit tile
+ */
+static inline void kernel64(const char *a, size_t lda, char *b, size_t ldb)
+{
+    __m128d r0 = _mm_loadu_pd((const double *)(a));
+    __m128d r1 = _mm_loadu_pd((const double *)(a + lda));
+
+    _mm_storeu_pd((double *)(b), _mm_unpacklo_pd(r0, r1));
+    _mm_storeu_pd((double *)(b + ldb), _mm_unpackhi_pd(r0, r1));
+}
+#define KERNEL64 kernel64
+#define KTILE64 2
+#else
+#define KERNEL64 NO_KERNEL
+#define KTILE64 0
+#endif
+
+_Static_assert(sizeof(pair32) == 8, "pair32 goes through the 64-bit kernel");
+
+DEFINE_TRANSPOSE(int8, int8_t, KERNEL8, KTILE8)
+DEFINE_TRANSPOSE(int16, int16_t, KERNEL16, KTILE16)
+DEFINE_TRANSPOSE(int32, int32_t, KERNEL32, KTILE32)
+DEFINE_TRANSPOSE(int64, int64_t, KERNEL64, KTILE64)
+DEFINE_TRANSPOSE(float, float, KERNEL32, KTILE32)
+DEFINE_TRANSPOSE(double, double, KERNEL64, KTILE64)
+DEFINE_TRANSPOSE(pair32, pair32, KERNEL64, KTILE64)
@@ -0,0 +1,79 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * trans_typed.h - transposes for 8-, 16-, 32- and 64-bit element types
+ *
+ * DEFINE_TRANSPOSE(NAME, T, KERNEL, KTILE) generates
+ *
+ *     void transpose_NAME(int M, int N, T A[N][M], T B[M][N]);
+ *
+ * blocked in TILE(T) x TILE(T) tiles, TILE(T) being the elements of T
+ * that share one LINE_BYTES line, so every line of A and B a tile touches
+ * is used whole. Inside a tile, KTILE x KTILE squares go through KERNEL,
+ * a register transpose taking byte pointers and byte strides (NO_KERNEL
+ * with KTILE 0 leaves only scalar copies). Everything is constant at
+ * compile time, so each instantiation is specialized like a template.
+ */
+#ifndef TRANS_TYPED_H
+#define TRANS_TYPED_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define LINE_BYTES 64 // real hardware, not the 1KB lab cache
+#define TILE(T) (sizeof(T) < LINE_BYTES ? (int)(LINE_BYTES / sizeof(T)) : 1)
+#define KSTEP(K) ((K) > 0 ? (K) : 1)
+
+/*KERNEL for types without a register transpose (KTILE 0)*/
+#define NO_KERNEL(a, lda, b, ldb) ((void)0)
+
+/*64-bit record, moved as one unit*/
+typedef struct{
+    int32_t key;
+    float value;
+} pair32;
+
+#define DEFINE_TRANSPOSE(NAME, T, KERNEL, KTILE)                                              \
+void transpose_##NAME(int M, int N, T A[N][M], T B[M][N])                                     \
+{                                                                                             \
+    for (int i = 0; i < N; i += TILE(T))                                                      \
+    {                                                                                         \
+        for (int j = 0; j < M; j += TILE(T))                                                  \
+        {                                                                                     \
+            int r1 = i + TILE(T) < N ? i + TILE(T) : N;                                       \
+            int c1 = j + TILE(T) < M ? j + TILE(T) : M;                                       \
+            int rk = i, ck = j;                                                               \
+                                                                                              \
+            if ((KTILE) > 0)                                                                  \
+            {                                                                                 \
+                rk = r1 - (r1 - i) % KSTEP(KTILE);                                            \
+                ck = c1 - (c1 - j) % KSTEP(KTILE);                                            \
+                for (int il = i; il < rk; il += KSTEP(KTILE))                                 \
+                {                                                                             \
+                    for (int jl = j; jl < ck; jl += KSTEP(KTILE))                             \
+                    {                                                                         \
+                        KERNEL((const char *)&A[il][jl], sizeof(T) * (size_t)M,              \
+                               (char *)&B[jl][il], sizeof(T) * (size_t)N);                    \
+                    }                                                                         \
+                }                                                                             \
+            }                                                                                 \
+            for (int il = i; il < r1; il++)                                                   \
+            {                                                                                 \
+                for (int jl = (il < rk ? ck : j); jl < c1; jl++)                              \
+                {                                                                             \
+                    memcpy(&B[jl][il], &A[il][jl], sizeof(T)); /* bits, like the kernels */   \
+                }                                                                             \
+            }                                                                                 \
+        }                                                                                     \
+    }                                                                                         \
+}
+
+void transpose_int8(int M, int N, int8_t A[N][M], int8_t B[M][N]);
+void transpose_int16(int M, int N, int16_t A[N][M], int16_t B[M][N]);
+void transpose_int32(int M, int N, int32_t A[N][M], int32_t B[M][N]);
+void transpose_int64(int M, int N, int64_t A[N][M], int64_t B[M][N]);
+void transpose_float(int M, int N, float A[N][M], float B[M][N]);
+void transpose_double(int M, int N, double A[N][M], double B[M][N]);
+void transpose_pair32(int M, int N, pair32 A[N][M], pair32 B[M][N]);
+
+#endif
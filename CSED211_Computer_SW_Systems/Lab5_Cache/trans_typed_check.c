@@ -0,0 +1,116 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * trans_typed_check.c - checks every transpose in trans_typed.c against a
+ *     scalar transpose, bit for bit, on shapes that leave partial tiles
+ *     and partial kernel squares on both edges
+ *
+ * build: gcc -O2 -march=native -o trans_typed_check trans_typed_check.c trans_typed.c
+ * usage: ./trans_typed_check [<M> <N> ...]
+ *
+ * A is filled with random bytes (so floats and doubles include NaNs and
+ * denormals, which must come through unchanged) and B with a pattern
+ * the transpose must overwrite completely. Build it once per instruction
+ * set (-mavx2, -mavx, -msse2 only, -mno-sse2) to cover every kernel.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trans_typed.h"
+
+static unsigned long long rng = 0x9E3779B97F4A7C15ull;
+
+static unsigned char next_byte(void){
+
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (unsigned char)(rng >> 32);
+}
+
+/*
+ * CHECK - check_NAME(M, N): 0 if transpose_NAME gives B[j][i] == A[i][j]
+ *     for every element, else report the first one that differs
+ */
+#define CHECK(NAME, T)                                                                        \
+static int check_##NAME(int M, int N)                                                         \
+{                                                                                             \
+    T *A = malloc(sizeof(T) * (size_t)M * N);                                                 \
+    T *B = malloc(sizeof(T) * (size_t)M * N);                                                 \
+    int bad = 0;                                                                              \
+                                                                                              \
+    if (A == NULL || B == NULL)                                                               \
+    {                                                                                         \
+        printf("%dx%d: allocation failed\n", M, N);                                         \
+        free(A);                                                                              \
+        free(B);                                                                              \
+        return 1;                                                                             \
+    }                                                                                         \
+    for (size_t k = 0; k < sizeof(T) * (size_t)M * N; k++)                                   \
+        ((unsigned char *)A)[k] = next_byte();                                                \
+    memset(B, 0xA5, sizeof(T) * (size_t)M * N);                                              \
+    transpose_##NAME(M, N, (T (*)[M])A, (T (*)[N])B);                                         \
+                                                                                              \
+    for (int i = 0; i < N && !bad; i++)                                                       \
+    {                                                                                         \
+        for (int j = 0; j < M && !bad; j++)                                                   \
+        {                                                                                     \
+            if (memcmp(&B[(size_t)j * N + i], &A[(size_t)i * M + j], sizeof(T)))              \
+            {                                                                                 \
+                printf("%-7s %5dx%-5d WRONG at A[%d][%d]\n", #NAME, M, N, i, j);            \
+                bad = 1;                                                                      \
+            }                                                                                 \
+        }                                                                                     \
+    }                                                                                         \
+    free(A);                                                                                  \
+    free(B);                                                                                  \
+    return bad;                                                                               \
+}
+
+CHECK(int8, int8_t)
+CHECK(int16, int16_t)
+CHECK(int32, int32_t)
+CHECK(int64, int64_t)
+CHECK(float, float)
+CHECK(double, double)
+CHECK(pair32, pair32)
+
+int (*checks[])(int M, int N) = {
+    check_int8, check_int16, check_int32, check_int64, check_float, check_double, check_pair32,
+};
+#define NCHECKS (int)(sizeof(checks) / sizeof(checks[0]))
+
+/*odd sizes next to the kernel squares (2..16) and tiles (8..64), plus tall and wide*/
+int shapes[][2] = {
+    {1, 1}, {1, 77}, {77, 1}, {2, 3}, {7, 9}, {15, 17}, {16, 16}, {17, 15}, {31, 33},
+    {63, 65}, {64, 64}, {65, 63}, {100, 7}, {7, 100}, {129, 127}, {257, 255}, {1000, 999},
+};
+#define NSHAPES (int)(sizeof(shapes) / sizeof(shapes[0]))
+
+int main(int argc, char *argv[])
+{
+
+    int failed = 0, checked = 0;
+
+    for(int a = 1; a < argc; a++){
+        if(argc % 2 == 0 || atoi(argv[a]) <= 0){
+            printf("usage: %s [<M> <N> ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    for(int f = 0; f < NCHECKS; f++){
+        if(argc > 1){
+            for(int a = 1; a + 1 < argc; a += 2){
+                failed += checks[f](atoi(argv[a]), atoi(argv[a + 1]));
+                checked++;
+            }
+        }
+        else{
+            for(int s = 0; s < NSHAPES; s++){
+                failed += checks[f](shapes[s][0], shapes[s][1]);
+                checked++;
+            }
+        }
+    }
+    printf("%d of %d transposes match the scalar one\n", checked - failed, checked);
+    return failed != 0;
+}
@@ -3,21 +3,42 @@
  *
  * <김문겸 kkomy 20220124>
  */
+#define _GNU_SOURCE /* pipe2, vmsplice, splice, mremap, fopencookie, cpu_set_t */
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
 #include <signal.h>
+#include <spawn.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <fcntl.h>
 #include <errno.h>
+#include <time.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <termios.h>
+#include <poll.h>
+#include <sys/ioctl.h>
 
 /* Misc manifest constants */
 #define MAXLINE 1024   /* max line size */
 #define MAXARGS 128    /* max args on a command line */
-#define MAXJOBS 16     /* max jobs at any point in time */
+#define MAXJOBS 16     /* initial job table size, doubled when full */
 #define MAXJID 1 << 16 /* max job ID */
+#define HASHBUCKETS 64 /* buckets in the command hash table */
+#define DEFPATH "/usr/bin:/bin" /* searched when PATH is unset */
+#define MAXSTAGES (MAXARGS / 2 + 1) /* max commands in a pipeline */
+#define OUTBUF_SIZE 65536 /* first mapping for captured builtin output */
+#define MAXEVENTS 256  /* child events held for the main routine, a power of two */
+#define NONICE (PRIO_MAX + 1) /* no nice level set */
+#define KEY_DEL 256    /* the Delete key, as editline sees it */
 
 /* Job states */
 #define UNDEF 0 /* undefined */
@@ -40,25 +61,227 @@ extern char **environ;   /* defined in libc */
 char prompt[] = "tsh> "; /* command line prompt (DO NOT CHANGE) */
 int verbose = 0;         /* if true, print additional output */
 int nextjid = 1;         /* next job ID to allocate */
+int nowait = 0;          /* script -j: eval starts FG jobs in the BG, silently */
+pid_t lastpid = 0;       /* leader PID of the job eval last started, 0 if none */
 char sbuf[MAXLINE];      /* for composing sprintf messages */
 
+struct usage_t
+{                          /* Resources used by a job */
+    struct timespec start; /* launch, CLOCK_MONOTONIC */
+    struct timespec end;   /* exit of its last process, 0 while running */
+    struct timeval utime;  /* user CPU of its reaped processes */
+    struct timeval stime;  /* system CPU of its reaped processes */
+    long maxrss;           /* largest max RSS among them, KB */
+    long nvcsw;            /* voluntary context switches */
+    long nivcsw;           /* involuntary context switches */
+};
+int timing = 0;                   /* eval runs for the time builtin: addjob marks the job */
+struct usage_t timed_usage;       /* usage of the last timed job to finish */
+int timed_done;                   /* set when timed_usage is filled in */
+
 struct job_t
-{                          /* The job struct */
-    pid_t pid;             /* job PID */
-    int jid;               /* job ID [1, 2, ...] */
-    int state;             /* UNDEF, BG, FG, or ST */
-    char cmdline[MAXLINE]; /* command line */
+{                       /* The job struct */
+    pid_t pid;          /* job PID */
+    int jid;            /* job ID [1, 2, ...] */
+    int state;          /* UNDEF, BG, FG, or ST */
+    char *cmdline;      /* command line, heap buffer kept with the slot */
+    size_t cmdline_cap; /* bytes allocated for cmdline */
+    int nprocs;         /* processes of the pipeline not yet reaped */
+    int termsig;        /* signal that killed one of them, 0 if none */
+    int timed;          /* started by the time builtin */
+    struct usage_t usage; /* from wait4, as its processes are reaped */
+    char *cgroup;       /* cgroup made for it by the limit settings, or NULL */
+};
+
+/*
+ * The job list: a growable array of slots with open-addressed hash
+ * indexes from pid and from jid to slot, so every lookup is O(1) no
+ * matter how many jobs there are. Index entries hold slot + 1; 0 is an
+ * empty entry and DELETED a removed one. The pid of every process in a
+ * pipeline is indexed, all of them leading to the pipeline's one job.
+ *
+ * Only the main routine reads or changes the list. sigchld_handler
+ * leaves what it reaps in the event ring below, and the signal
+ * forwarders read nothing but fg, so no SIGCHLD blocking is needed
+ * around any of it.
+ */
+struct joblist_t
+{
+    struct job_t *job;        /* slots */
+    int cap;                  /* number of slots */
+    int *free_slot;           /* stack of unused slots */
+    int nfree;                /* entries on free_slot */
+    struct index_t
+    {
+        struct
+        {
+            int key;  /* pid or jid */
+            int slot; /* slot + 1, 0 or DELETED */
+        } *entry;
+        int size; /* entries, a power of two */
+        int fill; /* live + DELETED entries */
+    } pids, jids;
+    volatile sig_atomic_t fg; /* PID of the FG job, 0 if none */
+};
+struct joblist_t jobs[1]; /* The job list (an array so it passes as a pointer) */
+#define DELETED -1
+
+/*
+ * The event ring: a lock-free queue with sigchld_handler as its only
+ * producer and drainevents, in the main routine, as its only consumer.
+ * The handler fills the slot at head and then publishes it by moving
+ * head; drainevents frees slots by moving tail. Each index is written
+ * by one side only, so a handler cutting into drainevents at any point
+ * still sees a consistent ring. A byte on the notify pipe wakes the
+ * main routine when it is waiting for an event (see waitevent).
+ */
+struct event_t
+{                     /* One wait4 result */
+    pid_t pid;        /* child reaped or stopped */
+    int status;       /* its wait status */
+    struct rusage ru; /* its resource usage, if it was reaped */
+};
+struct
+{
+    struct event_t ev[MAXEVENTS];
+    atomic_uint head;          /* next slot the handler fills */
+    atomic_uint tail;          /* next slot drainevents applies */
+    volatile sig_atomic_t full; /* handler stopped reaping for lack of room */
+} events;
+int notify_pipe[2]; /* sigchld_handler -> waitevent wakeups */
+
+struct cmd_t
+{                       /* A remembered PATH lookup */
+    char *name;         /* command as typed */
+    char *path;         /* where it was found */
+    int hits;           /* times it has been run from here */
+    struct cmd_t *next; /* next in the bucket */
 };
-struct job_t jobs[MAXJOBS]; /* The job list */
+struct cmd_t *cmdhash[HASHBUCKETS]; /* The command hash table */
+char *hashed_path;                  /* PATH that cmdhash was filled from, malloc'd */
+
+struct limits_t
+{                         /* Applied to a job's processes before execve */
+    rlim_t cpu;           /* RLIMIT_CPU seconds, RLIM_INFINITY if unset */
+    rlim_t as;            /* RLIMIT_AS bytes, ditto */
+    rlim_t nofile;        /* RLIMIT_NOFILE, ditto */
+    int nice;             /* nice level, NONICE if unset */
+    int ncpus;            /* CPUs in cpus, 0 if unset */
+    cpu_set_t cpus;       /* CPU affinity */
+    char cgroup[MAXLINE]; /* cgroup v2 directory each job gets a cgroup in, "" if unset */
+    char cpu_max[48];     /* cpu.max for the job's cgroup, "" to leave alone */
+    char memory_max[32];  /* memory.max, ditto */
+};
+struct limits_t limits;                /* set by the limit builtin for every job */
+struct limits_t *runlimits = &limits;  /* what eval applies: limits, or a one-off copy */
+
+struct stage_t
+{                  /* One command of a pipeline */
+    char **argv;   /* its words, NULL-terminated */
+    char *infile;  /* < file, or NULL */
+    char *outfile; /* > or >> file, or NULL */
+    int append;    /* outfile came with >> */
+    int err2out;   /* 2>&1: stderr goes where stdout goes */
+    int in_fd;     /* stdin, set up by eval */
+    int out_fd;    /* stdout, set up by eval */
+    struct limits_t *limits; /* applied before execve, set up by eval */
+    char *cgroup;  /* cgroup to join before execve, set up by eval, or NULL */
+};
+#define REDIRECTED(st) ((st)->infile || (st)->outfile || (st)->err2out)
+
+/* Operator tokens: parseline points argv at these, so a quoted '|' stays a word */
+char tok_pipe[] = "|", tok_in[] = "<", tok_out[] = ">", tok_append[] = ">>";
+char tok_err2out[] = "2>&1", tok_bg[] = "&";
+#define ISTOKEN(t) ((t) == tok_pipe || (t) == tok_in || (t) == tok_out || \
+                    (t) == tok_append || (t) == tok_err2out || (t) == tok_bg)
+
+struct cmdtime_t
+{                  /* One line of a script and how long it ran */
+    char *cmdline; /* the line */
+    pid_t pid;     /* leader PID while it runs in the batch, else 0 */
+    double start;  /* wall clock seconds */
+    double end;
+};
+
+struct script_t
+{                            /* A script being run by runscript */
+    char *map;               /* mmap'd script, or NULL to read file */
+    size_t size;             /* bytes mapped */
+    size_t off;              /* start of the next line in map */
+    FILE *file;              /* script that could not be mapped */
+    struct cmdtime_t *times; /* one per line run */
+    int *inflight;           /* indexes into times of running lines */
+    int running;             /* entries on inflight */
+};
+
+struct outbuf_t
+{                /* Builtin output collected for sendout */
+    char *buf;   /* mmap'd */
+    size_t len;  /* bytes written */
+    size_t cap;  /* bytes mapped */
+};
+
+struct posting_t
+{              /* History entries holding one bigram, oldest first */
+    int *id;
+    int n;
+    int cap;
+};
+struct
+{                       /* The command history */
+    int inited;         /* path and base are known */
+    char path[MAXLINE]; /* history file */
+    int fd;             /* open for appending, -1 until needed, -2 if there is none */
+    off_t base;         /* bytes of it written before this session */
+    char *map;          /* those bytes, mmap'd by histload */
+    int loaded;         /* map cut into entries */
+    struct
+    {
+        const char *s;  /* in map, or malloc'd for this session */
+        int len;        /* without the '\n' */
+    } *entry;           /* oldest first */
+    int n;
+    int cap;
+    struct posting_t *bigram; /* 1 << 16 lists, NULL until the first search */
+} hist;
+
+struct
+{                         /* The line editline is editing */
+    const char *prompt;
+    char buf[MAXLINE];    /* text, '\0'-terminated */
+    int len;
+    int pos;              /* cursor */
+    int hist;             /* history entry shown, hist.n for the line being typed */
+    char saved[MAXLINE];  /* the line being typed, while away from it */
+    int searching;        /* in reverse-i-search */
+    char query[MAXLINE];  /* what is searched for, qlen bytes */
+    int qlen;
+    int match;            /* entry found, -1 if none */
+    int raw;              /* terminal is in raw mode */
+    struct termios cooked; /* its modes before */
+} edit;
 /* End global variables */
 
 /* Function prototypes */
 
 /* Here are the functions that you will implement */
 void eval(char *cmdline);
+int spawnjob(struct stage_t *st, pid_t pgid, pid_t *pid);
+int spawnpath(char *path, struct stage_t *st, pid_t pgid, pid_t *pid);
+int openredirs(struct stage_t *st);
+void closeredirs(struct stage_t *st);
+void do_hash(char **argv);
 int builtin_cmd(char **argv);
+int isbuiltin(const char *name);
+void runbuiltin(char **argv, int fd);
+void sendout(int fd, char *buf, size_t len);
 void do_bgfg(char **argv);
+void do_time(char *cmdline);
+void do_limit(char *cmdline, char **argv);
 void waitfg(pid_t pid);
+void drainevents(void);
+void waitevent(void);
+void applyevent(pid_t pid, int status, const struct rusage *ru);
 
 void sigchld_handler(int sig);
 void sigtstp_handler(int sig);
@@ -66,18 +289,39 @@ void sigint_handler(int sig);
 
 /* Here are helper routines that we've provided for you */
 int parseline(const char *cmdline, char **argv);
+int parsepipe(char **argv, struct stage_t *stage);
 void sigquit_handler(int sig);
 
 void clearjob(struct job_t *job);
-void initjobs(struct job_t *jobs);
-int maxjid(struct job_t *jobs);
-int addjob(struct job_t *jobs, pid_t pid, int state, char *cmdline);
-int deletejob(struct job_t *jobs, pid_t pid);
-pid_t fgpid(struct job_t *jobs);
-struct job_t *getjobpid(struct job_t *jobs, pid_t pid);
-struct job_t *getjobjid(struct job_t *jobs, int jid);
+void initjobs(struct joblist_t *jobs);
+int growjobs(struct joblist_t *jobs);
+int maxjid(void);
+int addjob(struct joblist_t *jobs, pid_t pid, int state, char *cmdline);
+int addproc(struct joblist_t *jobs, pid_t leader, pid_t pid);
+int deletejob(struct joblist_t *jobs, pid_t pid);
+void setjobstate(struct joblist_t *jobs, struct job_t *job, int state);
+pid_t fgpid(struct joblist_t *jobs);
+struct job_t *getjobpid(struct joblist_t *jobs, pid_t pid);
+struct job_t *getjobjid(struct joblist_t *jobs, int jid);
 int pid2jid(pid_t pid);
-void listjobs(struct job_t *jobs);
+void listjobs(struct joblist_t *jobs, int usage);
+void addusage(struct usage_t *usage, const struct rusage *ru);
+void printusage(const struct usage_t *usage);
+
+char *findcmd(const char *name);
+void forgetcmd(const char *name);
+void flushcmds(void);
+
+void clearlimits(struct limits_t *lim);
+int haslimits(const struct limits_t *lim);
+char *makecgroup(const struct limits_t *lim);
+int forkpath(char *path, struct stage_t *st, pid_t pgid, pid_t *pid);
+
+void runscript(int fd, int njobs);
+
+int editline(const char *prompt, char *cmdline);
+void histadd(const char *line);
+void do_history(char **argv);
 
 void usage(void);
 void unix_error(char *msg);
@@ -93,13 +337,16 @@ int main(int argc, char **argv)
     char c;
     char cmdline[MAXLINE];
     int emit_prompt = 1; /* emit prompt (default) */
+    int njobs = 0;       /* script lines run at a time, 0 if interactive */
+    int fd = STDIN_FILENO;
+    int editing;         /* line editor and history on a terminal */
 
     /* Redirect stderr to stdout (so that driver will get all output
      * on the pipe connected to stdout) */
     dup2(1, 2);
 
     /* Parse the command line */
-    while ((c = getopt(argc, argv, "hvp")) != EOF)
+    while ((c = getopt(argc, argv, "hvpj:")) != EOF)
     {
         switch (c)
         {
@@ -112,11 +359,19 @@ int main(int argc, char **argv)
         case 'p':            /* don't print a prompt */
             emit_prompt = 0; /* handy for automatic testing */
             break;
+        case 'j': /* run script lines N at a time */
+            if ((njobs = atoi(optarg)) < 1)
+                usage();
+            break;
         default:
             usage();
         }
     }
 
+    /* The pipe sigchld_handler wakes us with; it must never block it */
+    if (pipe2(notify_pipe, O_CLOEXEC) < 0 || fcntl(notify_pipe[1], F_SETFL, O_NONBLOCK) < 0)
+        unix_error("pipe error");
+
     /* Install the signal handlers */
 
     /* These are the ones you will need to implement */
@@ -129,23 +384,52 @@ int main(int argc, char **argv)
 
     /* Initialize the job list */
     initjobs(jobs);
+    clearlimits(&limits);
+
+    /* Script mode: run a file (stdin with -j alone) and report times */
+    if (optind < argc || njobs > 0)
+    {
+        if (optind < argc && (fd = open(argv[optind], O_RDONLY | O_CLOEXEC)) < 0)
+            unix_error(argv[optind]);
+        runscript(fd, njobs ? njobs : 1);
+        exit(0);
+    }
+
+    /* The driver and -p get plain fgets, a person at a terminal gets editline */
+    editing = emit_prompt && isatty(STDIN_FILENO) && isatty(STDOUT_FILENO) &&
+              (getenv("TERM") == NULL || strcmp(getenv("TERM"), "dumb"));
 
     /* Execute the shell's read/eval loop */
     while (1)
     {
 
+        /* Report jobs that finished or stopped in the background */
+        drainevents();
+
         /* Read command line */
-        if (emit_prompt)
+        if (editing)
         {
-            printf("%s", prompt);
-            fflush(stdout);
+            if (!editline(prompt, cmdline))
+            { /* End of file (ctrl-d) */
+                fflush(stdout);
+                exit(0);
+            }
+            histadd(cmdline);
         }
-        if ((fgets(cmdline, MAXLINE, stdin) == NULL) && ferror(stdin))
-            app_error("fgets error");
-        if (feof(stdin))
-        { /* End of file (ctrl-d) */
-            fflush(stdout);
-            exit(0);
+        else
+        {
+            if (emit_prompt)
+            {
+                printf("%s", prompt);
+                fflush(stdout);
+            }
+            if ((fgets(cmdline, MAXLINE, stdin) == NULL) && ferror(stdin))
+                app_error("fgets error");
+            if (feof(stdin))
+            { /* End of file (ctrl-d) */
+                fflush(stdout);
+                exit(0);
+            }
         }
 
         /* Evaluate the command line */
@@ -160,140 +444,318 @@ int main(int argc, char **argv)
 /*
  * eval - Evaluate the command line that the user has just typed in
  *
- * If the user has requested a built-in command (quit, jobs, bg or fg)
- * then execute it immediately. Otherwise, fork a child process and
- * run the job in the context of the child. If the job is running in
+ * If the user has requested a built-in command (quit, jobs, bg, fg or hash)
+ * then execute it immediately. Otherwise, look argv[0] up in PATH unless it
+ * names a path itself, spawn a child process and run the job in the
+ * context of the child. If the job is running in
  * the foreground, wait for it to terminate and then return.  Note:
  * each child process must have a unique process group ID so that our
  * background children don't receive SIGINT (SIGTSTP) from the kernel
  * when we type ctrl-c (ctrl-z) at the keyboard.
+ *
+ * A pipeline is one job: every stage is spawned into the process group
+ * of the first, wired to its neighbours with pipes and to its own
+ * < > >> files. Builtins in a pipeline or with a redirection run in the
+ * shell after the other stages have started, so their output always
+ * has a reader (see runbuiltin).
  */
 void eval(char *cmdline)
 {
     char *argv[MAXARGS];
     char buf[MAXLINE];
-    int bg;
+    struct stage_t stage[MAXSTAGES];
+    int builtin_at[MAXSTAGES];
+    pid_t pids[MAXSTAGES];
+    int nstages, nbuiltins = 0, npids = 0;
+    int bg, i, err, in_fd, pfd[2];
     pid_t pid;
+    char *cgdir = NULL;
 
-    sigset_t block_vector;
-
+    drainevents(); // builtins and the job list see every child reaped so far
     strcpy(buf, cmdline);      // copy cmdline to buf
     bg = parseline(buf, argv); // parsing cmdline
 
     if (argv[0] == NULL)
         return;
-
-    if (!builtin_cmd(argv))
+    if (!strcmp(argv[0], "time")) // times the rest of the line, which it evals
+    {
+        do_time(cmdline);
+        return;
+    }
+    if (!strcmp(argv[0], "limit")) // settings, or a command to run under them
     {
+        do_limit(cmdline, argv);
+        return;
+    }
+    if ((nstages = parsepipe(argv, stage)) < 0) // split at |, take out < > >> 2>&1
+        return;
 
-        /*According to Hint*/
-        if (sigemptyset(&block_vector) != 0) // sigemptyset with error handling
-        {
-            unix_error("sigemptyset error");
-        }
-        if (sigaddset(&block_vector, SIGCHLD) != 0) // sigaddset with error handling
-        {
-            unix_error("sigaddset error");
+    if (nstages == 1 && !REDIRECTED(&stage[0]) && builtin_cmd(argv))
+        return;
+
+    /* A child that exits before addjob is safe without blocking SIGCHLD:
+     * its event waits in the ring until drainevents, after addjob */
+    if (runlimits->cgroup[0] != '\0' && (cgdir = makecgroup(runlimits)) == NULL)
+        return; // error handling: reported, nothing started
+    in_fd = STDIN_FILENO;
+    for (i = 0; i < nstages; i++)
+    {
+        struct stage_t *st = &stage[i];
+
+        st->in_fd = in_fd;
+        st->out_fd = STDOUT_FILENO;
+        st->limits = runlimits;
+        st->cgroup = cgdir;
+        in_fd = STDIN_FILENO;
+        if (i + 1 < nstages)
+        { // every fd the shell opens is close-on-exec, children get only 0, 1, 2
+            if (pipe2(pfd, O_CLOEXEC) < 0)
+            {
+                unix_error("pipe error");
+            }
+            st->out_fd = pfd[1];
+            in_fd = pfd[0];
         }
-        if (sigprocmask(SIG_BLOCK, &block_vector, NULL) != 0) // sigprocmask with error handling
-        {
-            unix_error("sigprocmask error");
-        } // SIGCHLD signal blocking
 
-        pid = fork();  // make child process
-        if (pid == -1) // error handling
+        if (openredirs(st) < 0) // error handling: stage is skipped, its pipes closed
         {
-            unix_error("fork error");
+            closeredirs(st);
+            continue;
         }
 
-        if (pid == 0)
+        if (isbuiltin(st->argv[0]))
         {
-
-            setpgid(0, 0);
-            if (sigprocmask(SIG_UNBLOCK, &block_vector, NULL) != 0) // unblocking
+            if (strcmp(st->argv[0], "jobs") && strcmp(st->argv[0], "hash") && strcmp(st->argv[0], "history"))
             {
-                unix_error("sigprocmask error");
+                printf("%s: cannot be used in a pipeline or redirected\n", st->argv[0]);
             }
-
-            if (execve(argv[0], argv, environ) < 0) // execute program
-            {
-                printf("%s: Command not found\n", argv[0]);
-                exit(0);
+            else
+            { // runs below, keeping its out_fd till then; it reads no input
+                builtin_at[nbuiltins++] = i;
+                if (st->in_fd != STDIN_FILENO)
+                    close(st->in_fd);
+                continue;
             }
         }
-
-        if (!bg) // foreground process
+        else if ((err = spawnjob(st, npids ? pids[0] : 0, &pid)) != 0)
         {
-            addjob(jobs, pid, FG, cmdline);
-            if (sigprocmask(SIG_UNBLOCK, &block_vector, NULL) != 0)
+            if (err == EAGAIN || err == ENOMEM) // error handling: no process was made
             {
-                unix_error("sigprocmask error");
-            }            // unblocking
-            waitfg(pid); // reaping process by using 'waitfg'
+                errno = err;
+                unix_error("spawn error");
+            }
+            if (err > 0) // -1: a limit could not be applied, already reported
+                printf("%s: Command not found\n", st->argv[0]); // execve itself failed
         }
-        else // background process
+        else
         {
-            addjob(jobs, pid, BG, cmdline); // calling addjob
-            if (sigprocmask(SIG_UNBLOCK, &block_vector, NULL) != 0)
-            {
-                unix_error("sigprocmask error");
-            } // unblocking
-            printf("[%d] (%d) %s", pid2jid(pid), (int)pid, cmdline);
+            pids[npids++] = pid;
         }
+        closeredirs(st);
+    }
+
+    lastpid = npids ? pids[0] : 0;
+    if (npids > 0 && addjob(jobs, pids[0], (bg || nowait) ? BG : FG, cmdline))
+    {
+        for (i = 1; i < npids; i++)
+            addproc(jobs, pids[0], pids[i]);
+        getjobpid(jobs, pids[0])->cgroup = cgdir; // deletejob removes it
+        cgdir = NULL;
+    }
+    if (cgdir != NULL) // no job to hand it to
+    {
+        rmdir(cgdir);
+        free(cgdir);
+    }
+    for (i = 0; i < nbuiltins; i++)
+    {
+        struct stage_t *st = &stage[builtin_at[i]];
+
+        runbuiltin(st->argv, st->out_fd);
+        if (st->out_fd != STDOUT_FILENO)
+            close(st->out_fd);
     }
+    if (npids == 0 || (nowait && !bg)) // runscript waits for the batch itself
+        return;
 
+    if (!bg) // foreground process
+    {
+        waitfg(pids[0]); // reaping process by using 'waitfg'
+    }
+    else // background process
+    {
+        printf("[%d] (%d) %s", pid2jid(pids[0]), (int)pids[0], cmdline);
+    }
     return;
 }
 
+/*
+ * spawnjob - Start the command of stage st in
+ *    process group pgid (0: a new group led by the command), with st's
+ *    in_fd and out_fd as its stdin and stdout, and store its PID in
+ *    *pid. Returns 0, or the error number of the failed fork or execve
+ *    (nothing is left running then), or -1 if one of st's limits could
+ *    not be applied (reported by forkpath).
+ *
+ * posix_spawn does what eval's child branch used to do by hand, but
+ * glibc runs it as vfork + execve in a child sharing our address space,
+ * so nothing is copied no matter how big the shell has grown, and an
+ * execve failure comes back here instead of dying in a child. Only a
+ * stage with limits to apply takes the fork path, see forkpath.
+ */
+int spawnjob(struct stage_t *st, pid_t pgid, pid_t *pid)
+{
+    char *name = st->argv[0];
+    char *path = strchr(name, '/') ? name : findcmd(name); // PATH lookup, cached
+    int err = path ? spawnpath(path, st, pgid, pid) : ENOENT;
+
+    if (path != name && (err == ENOENT || err == EACCES || err == ENOTDIR))
+    { // remembered file is gone or changed: search PATH again, once
+        forgetcmd(name);
+        path = findcmd(name);
+        err = path ? spawnpath(path, st, pgid, pid) : ENOENT;
+    }
+    return err;
+}
+
+/* spawnpath - spawnjob for a command already found at path */
+int spawnpath(char *path, struct stage_t *st, pid_t pgid, pid_t *pid)
+{
+    posix_spawnattr_t attr;
+    posix_spawn_file_actions_t actions;
+    int err;
+
+    if (st->cgroup != NULL || haslimits(st->limits))
+        return forkpath(path, st, pgid, pid);
+    if ((err = posix_spawnattr_init(&attr)) != 0)
+        return err;
+    if ((err = posix_spawn_file_actions_init(&actions)) != 0)
+    {
+        posix_spawnattr_destroy(&attr);
+        return err;
+    }
+    if ((err = posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP)) == 0 &&
+        (err = posix_spawnattr_setpgroup(&attr, pgid)) == 0 && // setpgid(0, pgid)
+        (st->in_fd == STDIN_FILENO || (err = posix_spawn_file_actions_adddup2(&actions, st->in_fd, STDIN_FILENO)) == 0) &&
+        (st->out_fd == STDOUT_FILENO || (err = posix_spawn_file_actions_adddup2(&actions, st->out_fd, STDOUT_FILENO)) == 0) &&
+        (!st->err2out || (err = posix_spawn_file_actions_adddup2(&actions, STDOUT_FILENO, STDERR_FILENO)) == 0))
+    {
+        err = posix_spawn(pid, path, &actions, &attr, st->argv, environ);
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    return err;
+}
+
+/*
+ * openredirs - Open the < and > / >> files of stage st in place of its
+ *    in_fd and out_fd. Returns 0, or -1 after reporting a file that
+ *    could not be opened.
+ */
+int openredirs(struct stage_t *st)
+{
+    int fd;
+
+    if (st->infile != NULL)
+    {
+        if ((fd = open(st->infile, O_RDONLY | O_CLOEXEC)) < 0)
+        {
+            printf("%s: %s\n", st->infile, strerror(errno));
+            return -1;
+        }
+        if (st->in_fd != STDIN_FILENO) // a < beats the pipe from the stage before
+            close(st->in_fd);
+        st->in_fd = fd;
+    }
+    if (st->outfile != NULL)
+    {
+        fd = open(st->outfile, O_WRONLY | O_CREAT | O_CLOEXEC | (st->append ? O_APPEND : O_TRUNC), 0666);
+        if (fd < 0)
+        {
+            printf("%s: %s\n", st->outfile, strerror(errno));
+            return -1;
+        }
+        if (st->out_fd != STDOUT_FILENO) // a > beats the pipe to the stage after
+            close(st->out_fd);
+        st->out_fd = fd;
+    }
+    return 0;
+}
+
+/* closeredirs - Close the shell's copies of stage st's in_fd and out_fd */
+void closeredirs(struct stage_t *st)
+{
+    if (st->in_fd != STDIN_FILENO)
+        close(st->in_fd);
+    if (st->out_fd != STDOUT_FILENO)
+        close(st->out_fd);
+}
+
 /*
  * parseline - Parse the command line and build the argv array.
  *
  * Characters enclosed in single quotes are treated as a single
  * argument.  Return true if the user has requested a BG job, false if
  * the user has requested a FG job.
+ *
+ * The operators | < > >> 2>&1 and & need no spaces around them. Each
+ * becomes an argv entry pointing at its tok_* string, so parsepipe can
+ * tell it from the same characters quoted as a word.
  */
 int parseline(const char *cmdline, char **argv)
 {
     static char array[MAXLINE]; /* holds local copy of command line */
+    static char words[2 * MAXLINE]; /* argv strings, each '\0'-terminated */
     char *buf = array;          /* ptr that traverses command line */
-    char *delim;                /* points to first space delimiter */
+    char *word = words;         /* where the next word is copied */
+    char *delim;                /* points to end of the word */
     int argc;                   /* number of args */
     int bg;                     /* background job? */
 
     strcpy(buf, cmdline);
-    buf[strlen(buf) - 1] = ' ';   /* replace trailing '\n' with space */
-    while (*buf && (*buf == ' ')) /* ignore leading spaces */
-        buf++;
+    buf[strlen(buf) - 1] = ' '; /* replace trailing '\n' with space */
 
     /* Build the argv list */
     argc = 0;
-    if (*buf == '\'')
+    while (argc < MAXARGS - 1)
     {
-        buf++;
-        delim = strchr(buf, '\'');
-    }
-    else
-    {
-        delim = strchr(buf, ' ');
-    }
-
-    while (delim)
-    {
-        argv[argc++] = buf;
-        *delim = '\0';
-        buf = delim + 1;
         while (*buf && (*buf == ' ')) /* ignore spaces */
             buf++;
+        if (*buf == '\0')
+            break;
 
-        if (*buf == '\'')
-        {
-            buf++;
-            delim = strchr(buf, '\'');
-        }
+        if (!strncmp(buf, "2>&1", 4))
+            argv[argc++] = tok_err2out;
+        else if (!strncmp(buf, ">>", 2))
+            argv[argc++] = tok_append;
+        else if (*buf == '>')
+            argv[argc++] = tok_out;
+        else if (*buf == '<')
+            argv[argc++] = tok_in;
+        else if (*buf == '|')
+            argv[argc++] = tok_pipe;
+        else if (*buf == '&')
+            argv[argc++] = tok_bg;
         else
-        {
-            delim = strchr(buf, ' ');
+        { /* a word: quoted, or up to a space or an operator */
+            if (*buf == '\'')
+            {
+                buf++;
+                if ((delim = strchr(buf, '\'')) == NULL)
+                    break; /* unterminated quote ends the line */
+            }
+            else
+            {
+                delim = buf + strcspn(buf, " |<>&");
+            }
+            argv[argc++] = word;
+            memcpy(word, buf, delim - buf);
+            word += delim - buf;
+            *word++ = '\0';
+            buf = (*delim == '\'') ? delim + 1 : delim;
+            continue;
         }
+        buf += strlen(argv[argc - 1]); /* step over the operator */
     }
     argv[argc] = NULL;
 
@@ -301,13 +763,80 @@ int parseline(const char *cmdline, char **argv)
         return 1;
 
     /* should the job run in the background? */
-    if ((bg = (*argv[argc - 1] == '&')) != 0)
+    if ((bg = (argv[argc - 1] == tok_bg)) != 0)
     {
         argv[--argc] = NULL;
     }
     return bg;
 }
 
+/*
+ * parsepipe - Split the argv of parseline into pipeline stages, in
+ *    place: each | becomes the NULL ending one stage's argv, and the
+ *    redirections are taken out into the stage they follow. Returns the
+ *    number of stages, or -1 after reporting a syntax error.
+ *
+ * 2>&1 sends stderr wherever the stage's stdout finally goes, whether
+ * it is written before or after a >.
+ */
+int parsepipe(char **argv, struct stage_t *stage)
+{
+    int n = 0, r, w = 0;
+    char *tok, *bad = NULL; /* token the syntax error is at */
+
+    memset(&stage[0], 0, sizeof(struct stage_t));
+    stage[0].argv = argv;
+    for (r = 0; (tok = argv[r]) != NULL; r++)
+    {
+        if (tok == tok_pipe)
+        {
+            if (stage[n].argv == &argv[w]) // error handling: ex) | wc
+            {
+                bad = tok;
+                break;
+            }
+            argv[w++] = NULL;
+            n++;
+            memset(&stage[n], 0, sizeof(struct stage_t));
+            stage[n].argv = &argv[w];
+        }
+        else if (tok == tok_in || tok == tok_out || tok == tok_append)
+        {
+            if (argv[r + 1] == NULL || ISTOKEN(argv[r + 1])) // error handling: ex) cat <
+            {
+                bad = argv[r + 1] ? argv[r + 1] : "newline";
+                break;
+            }
+            if (tok == tok_in)
+                stage[n].infile = argv[++r];
+            else
+            {
+                stage[n].outfile = argv[++r];
+                stage[n].append = (tok == tok_append);
+            }
+        }
+        else if (tok == tok_err2out)
+            stage[n].err2out = 1;
+        else if (tok == tok_bg) // error handling: ex) ls & wc
+        {
+            bad = tok;
+            break;
+        }
+        else
+            argv[w++] = tok;
+    }
+
+    if (bad == NULL && stage[n].argv == &argv[w]) // error handling: ex) ls | , > out
+        bad = (n > 0) ? "newline" : tok_out;
+    if (bad != NULL)
+    {
+        printf("syntax error near '%s'\n", bad);
+        return -1;
+    }
+    argv[w] = NULL;
+    return n + 1;
+}
+
 /*
  * builtin_cmd - If the user has typed a built-in command then execute
  *    it immediately.
@@ -333,13 +862,151 @@ int builtin_cmd(char **argv)
 
     if (!strcmp(argv[0], "jobs")) // job list print
     {
-        listjobs(jobs);
+        listjobs(jobs, argv[1] != NULL && !strcmp(argv[1], "-l")); // -l: with resource usage
+        return 1;
+    }
+
+    if (!strcmp(argv[0], "hash")) // remembered PATH lookups
+    {
+        do_hash(argv);
+        return 1;
+    }
+
+    if (!strcmp(argv[0], "history")) // command history
+    {
+        do_history(argv);
         return 1;
     }
 
     return 0; /* not a builtin command */
 }
 
+/* isbuiltin - True if builtin_cmd would run name itself */
+int isbuiltin(const char *name)
+{
+    return !strcmp(name, "quit") || !strcmp(name, "fg") || !strcmp(name, "bg") ||
+           !strcmp(name, "jobs") || !strcmp(name, "hash") || !strcmp(name, "time") ||
+           !strcmp(name, "limit") || !strcmp(name, "history");
+}
+
+/* outbuf_write - stdio write hook collecting builtin output in an outbuf_t */
+static ssize_t outbuf_write(void *cookie, const char *data, size_t size)
+{
+    struct outbuf_t *out = cookie;
+
+    if (out->len + size > out->cap)
+    {
+        size_t cap = out->cap ? out->cap : OUTBUF_SIZE;
+        void *buf;
+
+        while (cap < out->len + size)
+            cap *= 2;
+        if (out->buf == NULL)
+            buf = mmap(NULL, cap, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        else
+            buf = mremap(out->buf, out->cap, cap, MREMAP_MAYMOVE);
+        if (buf == MAP_FAILED)
+            return 0;
+        out->buf = buf;
+        out->cap = cap;
+    }
+    memcpy(out->buf + out->len, data, size);
+    out->len += size;
+    return size;
+}
+
+/*
+ * sendout - Move len bytes at buf to fd without copying them in user
+ *    space: into a pipe with vmsplice, which hands the kernel the pages
+ *    themselves, and into a regular file through a private pipe and
+ *    splice. Anything else (a terminal, an O_APPEND file) gets write.
+ *    buf must not be touched again until it is unmapped.
+ */
+void sendout(int fd, char *buf, size_t len)
+{
+    struct stat st = {0};
+    int pfd[2] = {-1, -1};
+    int to = fd;
+    handler_t *old_pipe = Signal(SIGPIPE, SIG_IGN); // reader may be gone: EPIPE, not death
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && !(fcntl(fd, F_GETFL) & O_APPEND) &&
+        pipe2(pfd, O_CLOEXEC) == 0)
+    {
+        to = pfd[1];
+    }
+
+    if (to == fd && !S_ISFIFO(st.st_mode))
+    {
+        ssize_t n;
+
+        while (len > 0 && (n = write(fd, buf, len)) > 0)
+        {
+            buf += n;
+            len -= n;
+        }
+    }
+    else
+    {
+        while (len > 0)
+        {
+            struct iovec iov = {buf, len};
+            ssize_t n = vmsplice(to, &iov, 1, 0), left;
+
+            if (n <= 0)
+                break;
+            for (left = n; to != fd && left > 0;) // drain the private pipe into the file
+            {
+                ssize_t moved = splice(pfd[0], NULL, fd, NULL, left, SPLICE_F_MOVE);
+
+                if (moved <= 0)
+                    break;
+                left -= moved;
+            }
+            buf += n;
+            len -= n;
+        }
+    }
+
+    if (pfd[0] >= 0)
+    {
+        close(pfd[0]);
+        close(pfd[1]);
+    }
+    Signal(SIGPIPE, old_pipe);
+}
+
+/*
+ * runbuiltin - Run builtin argv with its output going to fd. For fd
+ *    other than stdout, stdout is swapped for a stream that collects the
+ *    output in mmap'd memory, which sendout then hands over whole.
+ */
+void runbuiltin(char **argv, int fd)
+{
+    struct outbuf_t out = {NULL, 0, 0};
+    cookie_io_functions_t io = {NULL, outbuf_write, NULL, NULL};
+    FILE *saved = stdout;
+    FILE *capture;
+
+    if (fd == STDOUT_FILENO)
+    {
+        builtin_cmd(argv);
+        return;
+    }
+    if ((capture = fopencookie(&out, "w", io)) == NULL)
+        unix_error("fopencookie error");
+
+    fflush(stdout);
+    stdout = capture;
+    builtin_cmd(argv);
+    fclose(capture);
+    stdout = saved;
+
+    if (out.len > 0)
+        sendout(fd, out.buf, out.len);
+    if (out.buf != NULL)
+        munmap(out.buf, out.cap); // pages still in a pipe stay alive until read
+}
+
 /*
  * do_bgfg - Execute the builtin bg and fg commands
  */
@@ -347,7 +1014,6 @@ void do_bgfg(char **argv)
 {
     int job_num;
     int jid_check = 0; // check if number is JID: 1 is true, 0 is false
-    char temp[5];
     int nodgt_check = 0;
     struct job_t *newjob;
 
@@ -368,15 +1034,14 @@ void do_bgfg(char **argv)
     { // JID
 
         int i;
-        for (i = 1; argv[1][i] != '\0'; i++) // get jid number with for-loop
+        for (i = 1; argv[1][i] != '\0'; i++) // check that the jid is all digits
         {
-            temp[i - 1] = argv[1][i];
             if (!isdigit(argv[1][i]))
             {
                 nodgt_check = 1;
             }
         }
-        job_num = atoi(temp);
+        job_num = atoi(argv[1] + 1);
         jid_check = 1;
 
         if (nodgt_check == 1)
@@ -409,9 +1074,8 @@ void do_bgfg(char **argv)
     { // PID
 
         int i;
-        for (i = 0; argv[1][i] != '\0'; i++) // get pid number with for-loop
+        for (i = 0; argv[1][i] != '\0'; i++) // check that the pid is all digits
         {
-            temp[i] = argv[1][i];
             if (!isdigit(argv[1][i]))
             {
                 nodgt_check = 1;
@@ -456,73 +1120,193 @@ void do_bgfg(char **argv)
 
     if (!strcmp(argv[0], "fg"))
     {
-        newjob->state = FG;
+        setjobstate(jobs, newjob, FG);
         waitfg(newjob->pid); // if foreground, it need waitfg
     }
 
     if (!strcmp(argv[0], "bg"))
     {
-        newjob->state = BG;
+        setjobstate(jobs, newjob, BG);
         printf("[%d] (%d) %s", newjob->jid, newjob->pid, newjob->cmdline);
     }
 
     return;
 }
 
+/*
+ * do_time - Execute the builtin time command: run the rest of the line
+ *    as a job and, once it has finished, print its wall time and the
+ *    CPU time, max RSS and context switches of all its processes
+ */
+void do_time(char *cmdline)
+{
+    char *rest = cmdline + strspn(cmdline, " ");
+
+    rest += (*rest == '\'') ? strlen("'time'") : strlen("time");
+    rest += strspn(rest, " ");
+    if (*rest == '\n')
+    {
+        printf("time: usage: time command [args ...]\n");
+        return;
+    }
+
+    timed_done = 0;
+    lastpid = 0;
+    timing = 1;
+    eval(rest);
+    timing = 0;
+    if (lastpid == 0) // a builtin, or nothing could be started
+        return;
+
+    if (timed_done)
+    {
+        printusage(&timed_usage);
+        printf("\n");
+    }
+    else // background or stopped: jobs -l shows it so far
+    {
+        printf("time: job [%d] (%d) has not finished\n", pid2jid(lastpid), (int)lastpid);
+    }
+}
+
 /*
  * waitfg - Block until process pid is no longer the foreground process
+ *
+ * The job list only changes here in the main routine, so waitfg applies
+ * the events sigchld_handler has queued and sleeps on the notify pipe
+ * until there are more: a child that exits between the check and the
+ * read has already left a byte in the pipe, and the read returns at once.
  */
 void waitfg(pid_t pid)
 {
+    drainevents();
     while (pid == fgpid(jobs))
-    { // while loop until pid exists in foreground process
-        sleep(1);
+    {
+        waitevent();
     }
     return;
 }
 
-/*****************
- * Signal handlers
- *****************/
-
 /*
- * sigchld_handler - The kernel sends a SIGCHLD to the shell whenever
- *     a child job terminates (becomes a zombie), or stops because it
- *     received a SIGSTOP or SIGTSTP signal. The handler reaps all
- *     available zombie children, but doesn't wait for any other
- *     currently running children to terminate.
+ * drainevents - Apply every event in the ring to the job list, oldest
+ *    first. If the handler found the ring full, it is run again once
+ *    there is room, to reap the children it had to leave waiting.
  */
-void sigchld_handler(int sig)
+void drainevents(void)
 {
-    int statusp;
-    pid_t pid_num;
-    struct job_t *newjob;
+    unsigned tail = atomic_load_explicit(&events.tail, memory_order_relaxed);
+    unsigned head;
+
     while (1)
     {
-        pid_num = waitpid(-1, &statusp, WNOHANG | WUNTRACED); // if there is no child process, return -1 / if there is no stopped or terminated child process, return 0
-        if (pid_num == -1 || pid_num == 0)
+        head = atomic_load_explicit(&events.head, memory_order_acquire);
+        while (tail != head)
         {
-            break;
+            struct event_t *ev = &events.ev[tail % MAXEVENTS];
+
+            applyevent(ev->pid, ev->status, &ev->ru);
+            atomic_store_explicit(&events.tail, ++tail, memory_order_release);
         }
-        else
-        {
-            newjob = getjobpid(jobs, pid_num); // get job information
-            if (WIFSIGNALED(statusp))          // if terminated by signal
-            {
-                printf("Job [%d] (%d) terminated by signal 2\n", newjob->jid, newjob->pid);
-                deletejob(jobs, pid_num);
-            }
-            else if (WIFEXITED(statusp)) // if exited normally
-            {                            // for quit: there's no printed information
-                deletejob(jobs, pid_num);
-            }
-            else if (WIFSTOPPED(statusp)) // if stopped
+        if (!events.full)
+            break;
+        events.full = 0;
+        kill(getpid(), SIGCHLD); // handled before kill returns
+    }
+}
+
+/* waitevent - Sleep until sigchld_handler has queued an event, then apply it */
+void waitevent(void)
+{
+    char buf[64];
+
+    if (read(notify_pipe[0], buf, sizeof(buf)) < 0 && errno != EINTR)
+        unix_error("read error");
+    drainevents();
+}
+
+/*
+ * applyevent - Update the job list for child pid, which wait4 reported
+ *    with status and ru: account for it, and delete it once it has
+ *    terminated, or mark its job stopped
+ */
+void applyevent(pid_t pid, int status, const struct rusage *ru)
+{
+    struct job_t *job = getjobpid(jobs, pid);
+
+    if (job == NULL) // not one of ours (addjob failed)
+        return;
+    if (WIFSIGNALED(status) || WIFEXITED(status)) // if terminated by signal or exited normally
+    {
+        if (WIFSIGNALED(status))
+            job->termsig = WTERMSIG(status);
+        addusage(&job->usage, ru);
+        if (job->nprocs == 1) // the job's last process
+        {
+            clock_gettime(CLOCK_MONOTONIC, &job->usage.end);
+            if (job->timed)
             {
-                printf("Job [%d] (%d) stopped by signal 20\n", newjob->jid, newjob->pid);
-                newjob->state = ST;
+                timed_usage = job->usage;
+                timed_done = 1;
             }
+            if (job->termsig)
+                printf("Job [%d] (%d) terminated by signal %d\n", job->jid, job->pid, job->termsig);
+        }
+        deletejob(jobs, pid);
+    }
+    else if (WIFSTOPPED(status)) // if stopped
+    {
+        if (job->state != ST) // once, for the first process of the pipeline
+            printf("Job [%d] (%d) stopped by signal %d\n", job->jid, job->pid, WSTOPSIG(status));
+        setjobstate(jobs, job, ST);
+    }
+}
+
+/*****************
+ * Signal handlers
+ *****************/
+
+/*
+ * sigchld_handler - The kernel sends a SIGCHLD to the shell whenever
+ *     a child job terminates (becomes a zombie), or stops because it
+ *     received a SIGSTOP or SIGTSTP signal. The handler reaps all
+ *     available zombie children, but doesn't wait for any other
+ *     currently running children to terminate.
+ *
+ *     It touches nothing but the event ring and the notify pipe, with
+ *     async-signal-safe calls only: what the job list makes of each
+ *     child is up to applyevent. A child is only reaped when there is a
+ *     free slot for it; the rest stay zombies until drainevents makes
+ *     room and runs the handler again.
+ */
+void sigchld_handler(int sig)
+{
+    int olderrno = errno;
+    unsigned head = atomic_load_explicit(&events.head, memory_order_relaxed);
+    unsigned first = head;
+    pid_t pid_num;
+
+    while (1)
+    {
+        struct event_t *ev = &events.ev[head % MAXEVENTS];
+
+        if (head - atomic_load_explicit(&events.tail, memory_order_acquire) == MAXEVENTS)
+        {
+            events.full = 1;
+            break;
+        }
+        pid_num = wait4(-1, &ev->status, WNOHANG | WUNTRACED, &ev->ru); // if there is no child process, return -1 / if there is no stopped or terminated child process, return 0
+        if (pid_num == -1 || pid_num == 0)
+        {
+            break;
         }
+        ev->pid = pid_num;
+        atomic_store_explicit(&events.head, ++head, memory_order_release); // publish
+    }
+    if (head != first || events.full)
+    {
+        write(notify_pipe[1], "", 1); // EAGAIN: a wakeup is pending anyway
     }
+    errno = olderrno;
     return;
 }
 
@@ -533,14 +1317,14 @@ void sigchld_handler(int sig)
  */
 void sigint_handler(int sig)
 {
+    int olderrno = errno;
     pid_t pid_num = fgpid(jobs);
+
     if (pid_num > 0)
     {
-        if (kill(-pid_num, sig) == -1) // send SIGINT signal
-        {
-            unix_error("sigint error");
-        }
+        kill(-pid_num, sig); // send SIGINT signal; ESRCH: it has just exited, its event is queued
     }
+    errno = olderrno;
     return;
 }
 
@@ -551,15 +1335,14 @@ void sigint_handler(int sig)
  */
 void sigtstp_handler(int sig)
 {
+    int olderrno = errno;
     pid_t pid_num = fgpid(jobs);
 
     if (pid_num > 0)
     {
-        if (kill(-pid_num, sig) == -1) // send SIGTSTP signal
-        {
-            unix_error("sigtstp error");
-        }
+        kill(-pid_num, sig); // send SIGTSTP signal
     }
+    errno = olderrno;
     return;
 }
 
@@ -571,147 +1354,282 @@ void sigtstp_handler(int sig)
  * Helper routines that manipulate the job list
  **********************************************/
 
-/* clearjob - Clear the entries in a job struct */
+/* clearjob - Clear the entries in a job struct (the cmdline buffer stays) */
 void clearjob(struct job_t *job)
 {
     job->pid = 0;
     job->jid = 0;
     job->state = UNDEF;
-    job->cmdline[0] = '\0';
+    job->nprocs = 0;
+    job->termsig = 0;
+    job->timed = 0;
+    job->cgroup = NULL;
+    if (job->cmdline != NULL)
+        job->cmdline[0] = '\0';
+}
+
+/* index_find - Entry holding key, or the empty entry ending its probe */
+static int index_find(struct index_t *index, int key)
+{
+    int h = (int)(((unsigned)key * 2654435761u) >> 8) & (index->size - 1);
+    int slot;
+
+    while ((slot = index->entry[h].slot) != 0)
+    {
+        if (slot != DELETED && index->entry[h].key == key)
+            return h;
+        h = (h + 1) & (index->size - 1);
+    }
+    return h;
+}
+
+/* index_insert - Map key to slot in the first empty or DELETED entry */
+static void index_insert(struct index_t *index, int key, int slot)
+{
+    int h = (int)(((unsigned)key * 2654435761u) >> 8) & (index->size - 1);
+
+    while (index->entry[h].slot > 0)
+        h = (h + 1) & (index->size - 1);
+    if (index->entry[h].slot == 0)
+        index->fill++;
+    index->entry[h].key = key;
+    index->entry[h].slot = slot + 1;
+}
+
+/*
+ * index_reserve - Make room for one more entry, re-hashing into a table
+ *    at most half full and free of DELETED entries when the index is 3/4
+ *    full. Returns 0 if memory ran out.
+ */
+static int index_reserve(struct index_t *index)
+{
+    struct index_t old = *index;
+    int live = 0, size = old.size ? old.size : 2 * MAXJOBS;
+    int i;
+
+    if (4 * (old.fill + 1) <= 3 * old.size)
+        return 1;
+    for (i = 0; i < old.size; i++)
+        if (old.entry[i].slot > 0)
+            live++;
+    while (4 * (live + 1) > 2 * size)
+        size *= 2;
+
+    if ((index->entry = calloc(size, sizeof(*index->entry))) == NULL)
+    {
+        *index = old;
+        return 0;
+    }
+    index->size = size;
+    index->fill = 0;
+    for (i = 0; i < old.size; i++)
+        if (old.entry[i].slot > 0)
+            index_insert(index, old.entry[i].key, old.entry[i].slot - 1);
+    free(old.entry);
+    return 1;
 }
 
 /* initjobs - Initialize the job list */
-void initjobs(struct job_t *jobs)
+void initjobs(struct joblist_t *jobs)
+{
+    memset(jobs, 0, sizeof(*jobs));
+    if (!growjobs(jobs) || !index_reserve(&jobs->pids) || !index_reserve(&jobs->jids))
+        app_error("initjobs: out of memory");
+}
+
+/*
+ * growjobs - Double the number of slots (MAXJOBS to start with).
+ *    Returns 0 if memory ran out.
+ */
+int growjobs(struct joblist_t *jobs)
 {
+    int cap = jobs->cap ? 2 * jobs->cap : MAXJOBS;
+    struct job_t *job = realloc(jobs->job, cap * sizeof(struct job_t));
+    int *free_slot;
     int i;
 
-    for (i = 0; i < MAXJOBS; i++)
-        clearjob(&jobs[i]);
+    if (job == NULL)
+        return 0;
+    jobs->job = job;
+    if ((free_slot = realloc(jobs->free_slot, cap * sizeof(int))) == NULL)
+        return 0;
+    jobs->free_slot = free_slot;
+
+    for (i = cap - 1; i >= jobs->cap; i--)
+    { // lowest new slot on top of the stack
+        job[i].cmdline = NULL;
+        job[i].cmdline_cap = 0;
+        clearjob(&job[i]);
+        free_slot[jobs->nfree++] = i;
+    }
+    jobs->cap = cap;
+    return 1;
 }
 
 /* maxjid - Returns largest allocated job ID */
-int maxjid(struct job_t *jobs)
+int maxjid(void)
 {
-    int i, max = 0;
-
-    for (i = 0; i < MAXJOBS; i++)
-        if (jobs[i].jid > max)
-            max = jobs[i].jid;
-    return max;
+    return nextjid - 1; // deletejob keeps nextjid at maxjid + 1
 }
 
-/* addjob - Add a job to the job list */
-int addjob(struct job_t *jobs, pid_t pid, int state, char *cmdline)
+/* addjob - Add a job to the job list, with process pid as its leader */
+int addjob(struct joblist_t *jobs, pid_t pid, int state, char *cmdline)
 {
-    int i;
+    struct job_t *job;
+    size_t len = strlen(cmdline) + 1;
+    int slot;
 
     if (pid < 1)
         return 0;
 
-    for (i = 0; i < MAXJOBS; i++)
+    if ((jobs->nfree == 0 && !growjobs(jobs)) || !index_reserve(&jobs->pids) || !index_reserve(&jobs->jids))
+    { // out of slots or index entries, and no memory for more
+        printf("Tried to create too many jobs\n");
+        return 0;
+    }
+
+    slot = jobs->free_slot[jobs->nfree - 1];
+    job = &jobs->job[slot];
+    if (len > job->cmdline_cap)
     {
-        if (jobs[i].pid == 0)
+        char *buf = realloc(job->cmdline, len);
+
+        if (buf == NULL)
         {
-            jobs[i].pid = pid;
-            jobs[i].state = state;
-            jobs[i].jid = nextjid++;
-            if (nextjid > MAXJOBS)
-                nextjid = 1;
-            strcpy(jobs[i].cmdline, cmdline);
-            if (verbose)
-            {
-                printf("Added job [%d] %d %s\n", jobs[i].jid, jobs[i].pid, jobs[i].cmdline);
-            }
-            return 1;
+            printf("Tried to create too many jobs\n");
+            return 0;
         }
+        job->cmdline = buf;
+        job->cmdline_cap = len;
     }
-    printf("Tried to create too many jobs\n");
-    return 0;
+    jobs->nfree--;
+
+    job->pid = pid;
+    job->state = state;
+    job->jid = nextjid++;
+    job->nprocs = 1;
+    job->termsig = 0;
+    job->timed = timing;
+    memset(&job->usage, 0, sizeof(job->usage));
+    clock_gettime(CLOCK_MONOTONIC, &job->usage.start);
+    memcpy(job->cmdline, cmdline, len);
+    index_insert(&jobs->pids, pid, slot);
+    index_insert(&jobs->jids, job->jid, slot);
+    if (state == FG)
+        jobs->fg = pid;
+    if (verbose)
+    {
+        printf("Added job [%d] %d %s\n", job->jid, job->pid, job->cmdline);
+    }
+    return 1;
 }
 
-/* deletejob - Delete a job whose PID=pid from the job list */
-int deletejob(struct job_t *jobs, pid_t pid)
+/* addproc - Add process pid to the job led by process leader */
+int addproc(struct joblist_t *jobs, pid_t leader, pid_t pid)
 {
-    int i;
+    struct job_t *job = getjobpid(jobs, leader);
+
+    if (job == NULL || pid < 1 || !index_reserve(&jobs->pids))
+        return 0;
+    index_insert(&jobs->pids, pid, job - jobs->job);
+    job->nprocs++;
+    return 1;
+}
+
+/*
+ * deletejob - Delete process PID=pid from its job, and the job from
+ *    the job list once that was its last process
+ */
+int deletejob(struct joblist_t *jobs, pid_t pid)
+{
+    struct job_t *job;
+    int h;
 
     if (pid < 1)
         return 0;
 
-    for (i = 0; i < MAXJOBS; i++)
+    h = index_find(&jobs->pids, pid);
+    if (jobs->pids.entry[h].slot == 0)
+        return 0;
+    job = &jobs->job[jobs->pids.entry[h].slot - 1];
+    jobs->pids.entry[h].slot = DELETED;
+    if (--job->nprocs > 0) // rest of the pipeline still running
+        return 1;
+
+    if (jobs->fg == job->pid)
+        jobs->fg = 0;
+    jobs->jids.entry[index_find(&jobs->jids, job->jid)].slot = DELETED;
+    if (job->cgroup != NULL) // empty now that its last process is reaped
     {
-        if (jobs[i].pid == pid)
-        {
-            clearjob(&jobs[i]);
-            nextjid = maxjid(jobs) + 1;
-            return 1;
-        }
+        rmdir(job->cgroup);
+        free(job->cgroup);
     }
-    return 0;
+    jobs->free_slot[jobs->nfree++] = job - jobs->job;
+    clearjob(job);
+
+    while (nextjid > 1 && getjobjid(jobs, nextjid - 1) == NULL)
+        nextjid--; // back to maxjid + 1, each step undoes one addjob
+    return 1;
 }
 
-/* fgpid - Return PID of current foreground job, 0 if no such job */
-pid_t fgpid(struct job_t *jobs)
+/* setjobstate - Change a job's state, keeping track of the FG job */
+void setjobstate(struct joblist_t *jobs, struct job_t *job, int state)
 {
-    int i;
+    job->state = state;
+    if (state == FG)
+        jobs->fg = job->pid;
+    else if (jobs->fg == job->pid)
+        jobs->fg = 0;
+}
 
-    for (i = 0; i < MAXJOBS; i++)
-        if (jobs[i].state == FG)
-            return jobs[i].pid;
-    return 0;
+/* fgpid - Return PID of current foreground job, 0 if no such job */
+pid_t fgpid(struct joblist_t *jobs)
+{
+    return jobs->fg;
 }
 
-/* getjobpid  - Find a job (by PID) on the job list */
-struct job_t *getjobpid(struct job_t *jobs, pid_t pid)
+/* getjobpid  - Find a job (by the PID of any of its processes) on the job list */
+struct job_t *getjobpid(struct joblist_t *jobs, pid_t pid)
 {
-    int i;
+    int slot;
 
     if (pid < 1)
         return NULL;
-    for (i = 0; i < MAXJOBS; i++)
-        if (jobs[i].pid == pid)
-            return &jobs[i];
-    return NULL;
+    slot = jobs->pids.entry[index_find(&jobs->pids, pid)].slot;
+    return slot ? &jobs->job[slot - 1] : NULL;
 }
 
 /* getjobjid  - Find a job (by JID) on the job list */
-struct job_t *getjobjid(struct job_t *jobs, int jid)
+struct job_t *getjobjid(struct joblist_t *jobs, int jid)
 {
-    int i;
+    int slot;
 
     if (jid < 1)
         return NULL;
-    for (i = 0; i < MAXJOBS; i++)
-        if (jobs[i].jid == jid)
-            return &jobs[i];
-    return NULL;
+    slot = jobs->jids.entry[index_find(&jobs->jids, jid)].slot;
+    return slot ? &jobs->job[slot - 1] : NULL;
 }
 
 /* pid2jid - Map process ID to job ID */
 int pid2jid(pid_t pid)
 {
-    int i;
+    struct job_t *job = getjobpid(jobs, pid);
 
-    if (pid < 1)
-        return 0;
-    for (i = 0; i < MAXJOBS; i++)
-        if (jobs[i].pid == pid)
-        {
-            return jobs[i].jid;
-        }
-    return 0;
+    return job ? job->jid : 0;
 }
 
-/* listjobs - Print the job list */
-void listjobs(struct job_t *jobs)
+/* listjobs - Print the job list, in JID order, with resource usage if usage is set */
+void listjobs(struct joblist_t *jobs, int usage)
 {
-    int i;
+    struct job_t *job;
+    int jid;
 
-    for (i = 0; i < MAXJOBS; i++)
+    for (jid = 1; jid < nextjid; jid++)
     {
-        if (jobs[i].pid != 0)
+        if ((job = getjobjid(jobs, jid)) != NULL)
         {
-            printf("[%d] (%d) ", jobs[i].jid, jobs[i].pid);
-            switch (jobs[i].state)
+            printf("[%d] (%d) ", job->jid, job->pid);
+            switch (job->state)
             {
             case BG:
                 printf("Running ");
@@ -724,16 +1642,1460 @@ void listjobs(struct job_t *jobs)
                 break;
             default:
                 printf("listjobs: Internal error: job[%d].state=%d ",
-                       i, jobs[i].state);
+                       jid, job->state);
+            }
+            if (usage)
+            {
+                printusage(&job->usage);
+                printf(" ");
             }
-            printf("%s", jobs[i].cmdline);
+            printf("%s", job->cmdline);
         }
     }
 }
+
+/* addusage - Add what wait4 reported for one process to a job's usage */
+void addusage(struct usage_t *usage, const struct rusage *ru)
+{
+    timeradd(&usage->utime, &ru->ru_utime, &usage->utime);
+    timeradd(&usage->stime, &ru->ru_stime, &usage->stime);
+    if (ru->ru_maxrss > usage->maxrss)
+        usage->maxrss = ru->ru_maxrss;
+    usage->nvcsw += ru->ru_nvcsw;
+    usage->nivcsw += ru->ru_nivcsw;
+}
+
+/*
+ * printusage - Print a job's usage on one line, without the newline.
+ *    The wall time of a job still running is counted up to now, its
+ *    CPU time covers only the processes already reaped.
+ */
+void printusage(const struct usage_t *usage)
+{
+    struct timespec end = usage->end;
+
+    if (end.tv_sec == 0 && end.tv_nsec == 0)
+        clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("real %.3fs user %.3fs sys %.3fs maxrss %ldKB csw %ld+%ld",
+           (end.tv_sec - usage->start.tv_sec) + (end.tv_nsec - usage->start.tv_nsec) * 1e-9,
+           usage->utime.tv_sec + usage->utime.tv_usec * 1e-6,
+           usage->stime.tv_sec + usage->stime.tv_usec * 1e-6,
+           usage->maxrss, usage->nvcsw, usage->nivcsw);
+}
 /******************************
  * end job list helper routines
  ******************************/
 
+/***********************************************
+ * Command hash table: PATH lookup for argv[0]
+ **********************************************/
+
+/* hashname - FNV-1a hash of a command name, reduced to a bucket */
+static unsigned hashname(const char *name)
+{
+    unsigned h = 2166136261u;
+
+    while (*name)
+        h = (h ^ (unsigned char)*name++) * 16777619u;
+    return h & (HASHBUCKETS - 1);
+}
+
+/* flushcmds - Forget every remembered command (hash -r) */
+void flushcmds(void)
+{
+    struct cmd_t *cmd, *next;
+    int i;
+
+    for (i = 0; i < HASHBUCKETS; i++)
+    {
+        for (cmd = cmdhash[i]; cmd != NULL; cmd = next)
+        {
+            next = cmd->next;
+            free(cmd);
+        }
+        cmdhash[i] = NULL;
+    }
+}
+
+/* forgetcmd - Forget where name was found, e.g. after execve failed there */
+void forgetcmd(const char *name)
+{
+    struct cmd_t **link = &cmdhash[hashname(name)];
+    struct cmd_t *cmd;
+
+    for (; (cmd = *link) != NULL; link = &cmd->next)
+    {
+        if (!strcmp(cmd->name, name))
+        {
+            *link = cmd->next;
+            free(cmd);
+            return;
+        }
+    }
+}
+
+/*
+ * searchpath - Look for an executable regular file called name in each
+ *    directory of PATH, in order, and copy the first one found into
+ *    path. Returns 1 if one was found.
+ */
+static int searchpath(const char *name, char *path)
+{
+    const char *dir = hashed_path;
+    struct stat st;
+
+    while (1)
+    {
+        const char *end = strchr(dir, ':');
+        int len = end ? end - dir : (int)strlen(dir);
+
+        if (len == 0) // empty entry is the current directory
+            snprintf(path, MAXLINE, "%s", name);
+        else
+            snprintf(path, MAXLINE, "%.*s/%s", len, dir, name);
+        if (stat(path, &st) == 0 && S_ISREG(st.st_mode) && access(path, X_OK) == 0)
+            return 1;
+        if (end == NULL)
+            return 0;
+        dir = end + 1;
+    }
+}
+
+/*
+ * hashcmd - Return the table entry for command name (no '/' in it),
+ *    searching PATH and adding one if needed, or NULL if no PATH
+ *    directory has it. A name found before comes back without a single
+ *    system call; PATH is compared with the one the table was built
+ *    for, and a change empties it.
+ */
+static struct cmd_t *hashcmd(const char *name)
+{
+    const char *path_env = getenv("PATH");
+    struct cmd_t *cmd;
+    char path[MAXLINE];
+    unsigned h = hashname(name);
+
+    if (path_env == NULL)
+        path_env = DEFPATH;
+    if (hashed_path == NULL || strcmp(path_env, hashed_path) != 0)
+    {
+        flushcmds();
+        free(hashed_path); // a copy of any length: a cut-off one would never match again
+        if ((hashed_path = strdup(path_env)) == NULL)
+            app_error("hashcmd: out of memory");
+    }
+
+    for (cmd = cmdhash[h]; cmd != NULL; cmd = cmd->next)
+    {
+        if (!strcmp(cmd->name, name))
+            return cmd;
+    }
+
+    if (!searchpath(name, path))
+        return NULL;
+    /* one allocation holds the entry, its name and its path */
+    if ((cmd = malloc(sizeof(struct cmd_t) + strlen(name) + strlen(path) + 2)) == NULL)
+        app_error("findcmd: out of memory");
+    cmd->name = (char *)(cmd + 1);
+    cmd->path = cmd->name + strlen(name) + 1;
+    strcpy(cmd->name, name);
+    strcpy(cmd->path, path);
+    cmd->hits = 0;
+    cmd->next = cmdhash[h];
+    cmdhash[h] = cmd;
+    return cmd;
+}
+
+/* findcmd - Return the path to run for command name, NULL if not found */
+char *findcmd(const char *name)
+{
+    struct cmd_t *cmd = hashcmd(name);
+
+    if (cmd == NULL)
+        return NULL;
+    cmd->hits++;
+    return cmd->path;
+}
+
+/*
+ * do_hash - Execute the builtin hash command
+ *
+ *     hash              list remembered commands and how often each ran
+ *     hash -r           forget them all
+ *     hash name ...     look the names up now (without counting a hit)
+ */
+void do_hash(char **argv)
+{
+    struct cmd_t *cmd;
+    int i, any = 0;
+
+    if (argv[1] != NULL && !strcmp(argv[1], "-r"))
+    {
+        flushcmds();
+        return;
+    }
+
+    if (argv[1] != NULL)
+    {
+        for (i = 1; argv[i] != NULL; i++)
+        {
+            if (strchr(argv[i], '/') != NULL)
+                continue;
+            if (hashcmd(argv[i]) == NULL)
+                printf("hash: %s: not found\n", argv[i]);
+        }
+        return;
+    }
+
+    for (i = 0; i < HASHBUCKETS; i++)
+    {
+        for (cmd = cmdhash[i]; cmd != NULL; cmd = cmd->next)
+        {
+            if (!any++)
+                printf("hits\tcommand\n");
+            printf("%4d\t%s\n", cmd->hits, cmd->path);
+        }
+    }
+    if (!any)
+        printf("hash: hash table empty\n");
+}
+/***********************************************
+ * end command hash table
+ **********************************************/
+
+/***********************************************
+ * Job resource limits: the limit builtin
+ **********************************************/
+
+/* Steps of applylimits, as forkpath reports the one that failed */
+enum { STEP_EXEC, STEP_CGROUP, STEP_CPU, STEP_AS, STEP_NOFILE, STEP_NICE, STEP_CPUS };
+static const char *step_name[] = {"execve", "cgroup", "cpu", "as", "nofile", "nice", "cpus"};
+
+/* clearlimits - Unset every limit */
+void clearlimits(struct limits_t *lim)
+{
+    memset(lim, 0, sizeof(*lim));
+    lim->cpu = lim->as = lim->nofile = RLIM_INFINITY;
+    lim->nice = NONICE;
+}
+
+/* haslimits - True if lim sets anything a child has to apply itself */
+int haslimits(const struct limits_t *lim)
+{
+    return lim->cpu != RLIM_INFINITY || lim->as != RLIM_INFINITY || lim->nofile != RLIM_INFINITY ||
+           lim->nice != NONICE || lim->ncpus > 0 || lim->cgroup[0] != '\0';
+}
+
+/* parsesize - Read a count with an optional K, M or G suffix (powers of 1024) */
+static int parsesize(const char *s, rlim_t *size)
+{
+    char *end;
+    unsigned long long n;
+
+    if (!isdigit((unsigned char)*s))
+        return -1;
+    n = strtoull(s, &end, 10);
+    switch (*end)
+    {
+    case 'G':
+    case 'g':
+        n <<= 10; /* fall through */
+    case 'M':
+    case 'm':
+        n <<= 10; /* fall through */
+    case 'K':
+    case 'k':
+        n <<= 10;
+        end++;
+    }
+    if (*end != '\0' || n == RLIM_INFINITY)
+        return -1;
+    *size = n;
+    return 0;
+}
+
+/* parsecpus - Read a CPU list like 0-3,6 into set, returning how many CPUs it names */
+static int parsecpus(const char *s, cpu_set_t *set)
+{
+    char *end;
+    long lo, hi;
+    int n = 0;
+
+    CPU_ZERO(set);
+    while (1)
+    {
+        if (!isdigit((unsigned char)*s))
+            return -1;
+        lo = hi = strtol(s, &end, 10);
+        if (*end == '-')
+        {
+            if (!isdigit((unsigned char)end[1]))
+                return -1;
+            hi = strtol(end + 1, &end, 10);
+        }
+        if (hi < lo || hi >= CPU_SETSIZE)
+            return -1;
+        for (; lo <= hi; lo++, n++)
+            CPU_SET(lo, set);
+        if (*end == '\0')
+            return n;
+        if (*end != ',')
+            return -1;
+        s = end + 1;
+    }
+}
+
+/*
+ * setlimit - Apply one key=value word to lim; an empty value unsets the
+ *    key. Returns 0, or -1 after reporting a bad word.
+ */
+static int setlimit(struct limits_t *lim, char *word)
+{
+    char *value = strchr(word, '=') + 1;
+    size_t keylen = value - 1 - word;
+    int unset = (*value == '\0');
+    rlim_t n;
+    char *end;
+
+#define KEY(k) (keylen == strlen(k) && !strncmp(word, k, keylen))
+    if (KEY("cpu") || KEY("nofile"))
+    {
+        rlim_t *field = KEY("cpu") ? &lim->cpu : &lim->nofile;
+
+        if (unset)
+            *field = RLIM_INFINITY;
+        else if (!isdigit((unsigned char)*value) || (n = strtoull(value, &end, 10)) == RLIM_INFINITY || *end != '\0')
+            goto bad;
+        else
+            *field = n;
+    }
+    else if (KEY("as"))
+    {
+        if (unset)
+            lim->as = RLIM_INFINITY;
+        else if (parsesize(value, &lim->as) < 0)
+            goto bad;
+    }
+    else if (KEY("nice"))
+    {
+        long nice = strtol(value, &end, 10);
+
+        if (unset)
+            lim->nice = NONICE;
+        else if (*end != '\0' || end == value || nice < PRIO_MIN || nice >= PRIO_MAX)
+            goto bad;
+        else
+            lim->nice = nice;
+    }
+    else if (KEY("cpus"))
+    {
+        if (unset)
+            lim->ncpus = 0;
+        else if ((lim->ncpus = parsecpus(value, &lim->cpus)) < 0)
+        {
+            lim->ncpus = 0;
+            goto bad;
+        }
+    }
+    else if (KEY("cgroup"))
+    {
+        if (!unset && *value != '/')
+            goto bad;
+        strcpy(lim->cgroup, value); // fits: word came from a command line
+        while (strlen(lim->cgroup) > 1 && lim->cgroup[strlen(lim->cgroup) - 1] == '/')
+            lim->cgroup[strlen(lim->cgroup) - 1] = '\0';
+    }
+    else if (KEY("cpu.max")) // quota[,period] in microseconds, quota may be max
+    {
+        long quota = 0, period = 100000; // quota 0: max
+
+        if (unset)
+        {
+            lim->cpu_max[0] = '\0';
+            return 0;
+        }
+        if (!strncmp(value, "max", 3))
+            end = value + 3;
+        else if ((quota = strtol(value, &end, 10)) <= 0 || end == value)
+            goto bad;
+        if (*end == ',' && ((period = strtol(end + 1, &end, 10)) <= 0))
+            goto bad;
+        if (*end != '\0')
+            goto bad;
+        if (quota > 0)
+            sprintf(lim->cpu_max, "%ld %ld", quota, period);
+        else
+            sprintf(lim->cpu_max, "max %ld", period);
+    }
+    else if (KEY("memory.max")) // bytes with K/M/G, or max
+    {
+        if (unset)
+            lim->memory_max[0] = '\0';
+        else if (!strcmp(value, "max"))
+            strcpy(lim->memory_max, "max");
+        else if (parsesize(value, &n) < 0)
+            goto bad;
+        else
+            sprintf(lim->memory_max, "%llu", (unsigned long long)n);
+    }
+    else
+        goto bad;
+#undef KEY
+    return 0;
+
+bad:
+    printf("limit: bad setting '%s'\n", word);
+    return -1;
+}
+
+/* printsize - Print a byte count with the largest suffix that divides it */
+static void printsize(rlim_t n)
+{
+    const char *suffix = "KMG";
+    int i = -1;
+
+    while (i < 2 && n > 0 && n % 1024 == 0)
+    {
+        n /= 1024;
+        i++;
+    }
+    printf("%llu%.*s", (unsigned long long)n, i >= 0, i >= 0 ? suffix + i : "");
+}
+
+/* printlimits - Print lim as the key=value words that set it */
+static void printlimits(const struct limits_t *lim)
+{
+    int cpu, start, first = 1;
+
+    if (!haslimits(lim) && !lim->cpu_max[0] && !lim->memory_max[0])
+    {
+        printf("limit: no limits set\n");
+        return;
+    }
+    if (lim->cpu != RLIM_INFINITY)
+        printf("cpu=%llu ", (unsigned long long)lim->cpu);
+    if (lim->as != RLIM_INFINITY)
+    {
+        printf("as=");
+        printsize(lim->as);
+        printf(" ");
+    }
+    if (lim->nofile != RLIM_INFINITY)
+        printf("nofile=%llu ", (unsigned long long)lim->nofile);
+    if (lim->nice != NONICE)
+        printf("nice=%d ", lim->nice);
+    if (lim->ncpus > 0)
+    {
+        printf("cpus=");
+        for (cpu = 0, start = -1; cpu <= CPU_SETSIZE; cpu++)
+        {
+            if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &lim->cpus))
+            {
+                if (start < 0)
+                    start = cpu;
+                continue;
+            }
+            if (start >= 0)
+            {
+                printf(start == cpu - 1 ? "%s%d" : "%s%d-%d", first ? "" : ",", start, cpu - 1);
+                start = -1;
+                first = 0;
+            }
+        }
+        printf(" ");
+    }
+    if (lim->cgroup[0] != '\0')
+        printf("cgroup=%s ", lim->cgroup);
+    if (lim->cpu_max[0] != '\0')
+    {
+        const char *space = strchr(lim->cpu_max, ' ');
+
+        printf("cpu.max=%.*s,%s ", (int)(space - lim->cpu_max), lim->cpu_max, space + 1);
+    }
+    if (lim->memory_max[0] != '\0')
+        printf("memory.max=%s ", lim->memory_max);
+    printf("\n");
+}
+
+/* skipword - Step over one word of a command line and the spaces after it */
+static char *skipword(char *s)
+{
+    s += strspn(s, " ");
+    if (*s == '\'' && strchr(s + 1, '\'') != NULL)
+        s = strchr(s + 1, '\'') + 1;
+    else
+        s += strcspn(s, " \n");
+    return s + strspn(s, " ");
+}
+
+/*
+ * do_limit - Execute the builtin limit command
+ *
+ *     limit                          list the settings every job starts with
+ *     limit reset                    clear them all
+ *     limit key=value ...            change them (key= clears one)
+ *     limit key=value ... command    run just this command with them changed
+ *
+ * cpu (seconds), as (bytes, K/M/G) and nofile are rlimits, hard and soft;
+ * nice is a nice level and cpus a CPU list like 0-3,6 for sched_setaffinity.
+ * With cgroup set to a cgroup v2 directory, each job gets a cgroup of its
+ * own under it, with cpu.max (quota[,period] in us) and memory.max (bytes
+ * or max) written to it when they are set.
+ */
+void do_limit(char *cmdline, char **argv)
+{
+    struct limits_t once, *saved = runlimits;
+    char *rest;
+    int i;
+
+    if (argv[1] == NULL)
+    {
+        printlimits(&limits);
+        return;
+    }
+    if (!strcmp(argv[1], "reset") && argv[2] == NULL)
+    {
+        clearlimits(&limits);
+        return;
+    }
+
+    once = *runlimits; // limit ... limit ... command stacks them
+    rest = skipword(cmdline);
+    for (i = 1; argv[i] != NULL && !ISTOKEN(argv[i]) && strchr(argv[i], '=') != NULL; i++)
+    {
+        if (setlimit(&once, argv[i]) < 0)
+            return;
+        rest = skipword(rest);
+    }
+
+    if ((once.cpu_max[0] || once.memory_max[0]) && once.cgroup[0] == '\0')
+        printf("limit: cpu.max and memory.max take effect once cgroup is set\n");
+    if (argv[i] == NULL) // settings only: keep them
+    {
+        if (runlimits == &limits)
+            limits = once;
+        return;
+    }
+    runlimits = &once;
+    eval(rest);
+    runlimits = saved;
+}
+
+/*
+ * makecgroup - Make a cgroup for one job under lim->cgroup, with lim's
+ *    cpu.max and memory.max. Returns its path (malloc'd), or NULL after
+ *    reporting what failed.
+ */
+char *makecgroup(const struct limits_t *lim)
+{
+    static int seq = 0;
+    char dir[MAXLINE + 32];
+    char file[MAXLINE + 64];
+    const char *key[2] = {"cpu.max", "memory.max"};
+    const char *value[2] = {lim->cpu_max, lim->memory_max};
+    char *copy;
+    int i, fd;
+
+    sprintf(dir, "%s/tsh-%d-%d", lim->cgroup, (int)getpid(), ++seq);
+    if (mkdir(dir, 0755) < 0)
+    {
+        printf("limit: %s: %s\n", dir, strerror(errno));
+        return NULL;
+    }
+    for (i = 0; i < 2; i++)
+    {
+        if (value[i][0] == '\0')
+            continue;
+        sprintf(file, "%s/%s", dir, key[i]);
+        if ((fd = open(file, O_WRONLY | O_CLOEXEC)) < 0 || write(fd, value[i], strlen(value[i])) < 0)
+        { // ENOENT: the controller is not in the parent's cgroup.subtree_control
+            printf("limit: %s: %s\n", file, strerror(errno));
+            if (fd >= 0)
+                close(fd);
+            rmdir(dir);
+            return NULL;
+        }
+        close(fd);
+    }
+    if ((copy = strdup(dir)) == NULL)
+        app_error("makecgroup: out of memory");
+    return copy;
+}
+
+/*
+ * applylimits - In the child, join st's cgroup and apply its limits.
+ *    Returns 0, or the STEP_ that failed with errno set.
+ */
+static int applylimits(struct stage_t *st)
+{
+    const struct limits_t *lim = st->limits;
+    struct rlimit rl;
+    char buf[MAXLINE + 64];
+    int fd, len;
+
+    if (st->cgroup != NULL) // before anything runs, so the whole job is charged
+    {
+        sprintf(buf, "%s/cgroup.procs", st->cgroup);
+        if ((fd = open(buf, O_WRONLY)) < 0)
+            return STEP_CGROUP;
+        len = sprintf(buf, "%d\n", (int)getpid());
+        if (write(fd, buf, len) != len)
+            return STEP_CGROUP;
+        close(fd);
+    }
+    if (lim->cpu != RLIM_INFINITY)
+    {
+        rl.rlim_cur = rl.rlim_max = lim->cpu;
+        if (setrlimit(RLIMIT_CPU, &rl) < 0)
+            return STEP_CPU;
+    }
+    if (lim->as != RLIM_INFINITY)
+    {
+        rl.rlim_cur = rl.rlim_max = lim->as;
+        if (setrlimit(RLIMIT_AS, &rl) < 0)
+            return STEP_AS;
+    }
+    if (lim->nofile != RLIM_INFINITY)
+    {
+        rl.rlim_cur = rl.rlim_max = lim->nofile;
+        if (setrlimit(RLIMIT_NOFILE, &rl) < 0)
+            return STEP_NOFILE;
+    }
+    if (lim->nice != NONICE && setpriority(PRIO_PROCESS, 0, lim->nice) < 0)
+        return STEP_NICE;
+    if (lim->ncpus > 0 && sched_setaffinity(0, sizeof(lim->cpus), &lim->cpus) < 0)
+        return STEP_CPUS;
+    return 0;
+}
+
+/*
+ * forkpath - spawnpath for a stage with limits: what posix_spawn cannot
+ *    do happens in a forked child between setpgid and execve. A failure
+ *    there comes back over a close-on-exec pipe, which reads as EOF once
+ *    execve has succeeded.
+ */
+int forkpath(char *path, struct stage_t *st, pid_t pgid, pid_t *pid)
+{
+    int pfd[2], report[2], err;
+    ssize_t n;
+
+    if (pipe2(pfd, O_CLOEXEC) < 0)
+        return errno;
+    if ((*pid = fork()) < 0)
+    {
+        err = errno;
+        close(pfd[0]);
+        close(pfd[1]);
+        return err;
+    }
+
+    if (*pid == 0) // child
+    {
+        signal(SIGINT, SIG_DFL); // what posix_spawn gets from execve alone
+        signal(SIGTSTP, SIG_DFL);
+        signal(SIGCHLD, SIG_DFL);
+        setpgid(0, pgid);
+        if ((st->in_fd != STDIN_FILENO && dup2(st->in_fd, STDIN_FILENO) < 0) ||
+            (st->out_fd != STDOUT_FILENO && dup2(st->out_fd, STDOUT_FILENO) < 0) ||
+            (st->err2out && dup2(STDOUT_FILENO, STDERR_FILENO) < 0))
+        {
+            report[0] = STEP_EXEC;
+        }
+        else if ((report[0] = applylimits(st)) == 0)
+        {
+            execve(path, st->argv, environ);
+            report[0] = STEP_EXEC;
+        }
+        report[1] = errno;
+        write(pfd[1], report, sizeof(report));
+        _exit(127);
+    }
+
+    close(pfd[1]);
+    setpgid(*pid, pgid ? pgid : *pid); // as the child does, whichever runs first
+    n = read(pfd[0], report, sizeof(report));
+    close(pfd[0]);
+    if (n != sizeof(report)) // EOF: execve succeeded
+        return 0;
+    if (report[0] == STEP_EXEC) // the child's event is dropped by applyevent
+        return report[1];
+    printf("%s: limit %s: %s\n", st->argv[0], step_name[report[0]], strerror(report[1]));
+    return -1;
+}
+/***********************************************
+ * end job resource limits
+ **********************************************/
+
+/***********************************************
+ * Script mode: tsh [-j N] script
+ **********************************************/
+
+/* now - Monotonic wall clock in seconds */
+static double now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/*
+ * nextline - Copy the next line of the script into cmdline, always
+ *    '\n'-terminated as eval expects. Returns 0 at the end. An mmap'd
+ *    script is cut with memchr, anything else (a pipe, a terminal) is
+ *    read through a large stdio buffer.
+ */
+static int nextline(struct script_t *sc, char *cmdline)
+{
+    while (sc->map != NULL)
+    {
+        char *start = sc->map + sc->off;
+        char *end;
+        size_t len;
+
+        if (sc->off >= sc->size)
+            return 0;
+        end = memchr(start, '\n', sc->size - sc->off);
+        len = end ? (size_t)(end - start) : sc->size - sc->off;
+        sc->off += len + 1;
+        if (len > MAXLINE - 2)
+        {
+            printf("script: line too long, skipped\n");
+            continue;
+        }
+        memcpy(cmdline, start, len);
+        cmdline[len] = '\n';
+        cmdline[len + 1] = '\0';
+        return 1;
+    }
+
+    if (fgets(cmdline, MAXLINE, sc->file) == NULL)
+        return 0;
+    if (cmdline[strlen(cmdline) - 1] != '\n' && strlen(cmdline) < MAXLINE - 1)
+        strcat(cmdline, "\n"); // last line without a newline
+    return 1;
+}
+
+/*
+ * reap_batch - Wait until a job of the batch has finished (all of them
+ *    if all is set) and stamp its end time. Jobs are gone from the job
+ *    list once drainevents has applied the reaping of their last process.
+ */
+static void reap_batch(struct script_t *sc, int all)
+{
+    int i, done = 0;
+
+    drainevents();
+    while (sc->running > 0 && (all || !done))
+    {
+        for (i = 0; i < sc->running; i++)
+        {
+            struct cmdtime_t *ct = &sc->times[sc->inflight[i]];
+
+            if (getjobpid(jobs, ct->pid) == NULL)
+            {
+                ct->end = now();
+                sc->inflight[i--] = sc->inflight[--sc->running];
+                done++;
+            }
+        }
+        if (sc->running > 0 && (all || !done))
+            waitevent(); // until the next child is reaped
+    }
+}
+
+/*
+ * runscript - Run every line of the script open on fd, up to njobs
+ *    lines at a time, then print how long each line and the whole script
+ *    took. With njobs > 1 lines are taken to be independent and run as
+ *    silent background jobs; a builtin or a line ending in & first waits
+ *    for the whole batch, then runs on its own.
+ */
+void runscript(int fd, int njobs)
+{
+    struct script_t sc;
+    struct stat st;
+    char cmdline[MAXLINE];
+    char *argv[MAXARGS];
+    double start = now(), busy = 0;
+    int n = 0, cap = 1024, i;
+
+    memset(&sc, 0, sizeof(sc));
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+        (sc.map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0)) != MAP_FAILED)
+    {
+        sc.size = st.st_size;
+        madvise(sc.map, sc.size, MADV_SEQUENTIAL);
+    }
+    else
+    {
+        sc.map = NULL;
+        if ((sc.file = fdopen(fd, "r")) == NULL)
+            unix_error("script error");
+        setvbuf(sc.file, NULL, _IOFBF, 1 << 16);
+    }
+    if ((sc.times = malloc(cap * sizeof(struct cmdtime_t))) == NULL ||
+        (sc.inflight = malloc(njobs * sizeof(int))) == NULL)
+        app_error("runscript: out of memory");
+
+    while (nextline(&sc, cmdline))
+    {
+        struct cmdtime_t *ct;
+        int bg;
+
+        bg = parseline(cmdline, argv);
+        if (argv[0] == NULL) // blank line
+            continue;
+        if (n == cap && (sc.times = realloc(sc.times, (cap *= 2) * sizeof(struct cmdtime_t))) == NULL)
+            app_error("runscript: out of memory");
+        ct = &sc.times[n++];
+        if ((ct->cmdline = strdup(cmdline)) == NULL)
+            app_error("runscript: out of memory");
+
+        if (njobs == 1 || bg || isbuiltin(argv[0]))
+        { // serially: eval waits for a FG job itself
+            reap_batch(&sc, 1);
+            ct->start = now();
+            eval(cmdline);
+            ct->end = now();
+            ct->pid = 0;
+        }
+        else
+        {
+            if (sc.running == njobs)
+                reap_batch(&sc, 0);
+            nowait = 1;
+            ct->start = now();
+            eval(cmdline);
+            nowait = 0;
+            if ((ct->pid = lastpid) == 0) // nothing was started
+                ct->end = now();
+            else
+                sc.inflight[sc.running++] = ct - sc.times;
+        }
+        fflush(stdout);
+    }
+    reap_batch(&sc, 1);
+
+    for (i = 0; i < n; i++)
+        busy += sc.times[i].end - sc.times[i].start;
+    printf("# script: %d commands, %d at a time: %.6f s wall, %.6f s summed\n",
+           n, njobs, now() - start, busy);
+    for (i = 0; i < n; i++)
+    {
+        printf("# %10.6f s  %s", sc.times[i].end - sc.times[i].start, sc.times[i].cmdline);
+        free(sc.times[i].cmdline);
+    }
+    fflush(stdout);
+
+    free(sc.times);
+    free(sc.inflight);
+    if (sc.map != NULL)
+        munmap(sc.map, sc.size);
+}
+/***********************************************
+ * end script mode
+ **********************************************/
+
+/***********************************************
+ * Line editor and history
+ **********************************************/
+
+/*
+ * The history file is append-only: each accepted line is added with one
+ * O_APPEND write, so shells sharing the file never tear each other's
+ * lines. Nothing of it is read at startup. The first history key mmaps
+ * the part that was there when this shell started and cuts it into
+ * entries with memchr; lines of this session follow them. Reverse search
+ * goes through an index from each pair of adjacent bytes (bigram) to the
+ * entries holding it, newest last, built on the first ^R: a query is
+ * only checked against the entries on its rarest bigram's list.
+ */
+
+/* histinit - Find the history file and how much of it predates this session */
+static void histinit(void)
+{
+    const char *file = getenv("TSH_HISTORY");
+    const char *home = getenv("HOME");
+    struct stat st;
+
+    if (hist.inited++)
+        return;
+    hist.fd = -1;
+    if (file != NULL && *file != '\0' && strlen(file) < MAXLINE)
+        strcpy(hist.path, file);
+    else if (home != NULL && strlen(home) + strlen("/.tsh_history") < MAXLINE)
+        sprintf(hist.path, "%s/.tsh_history", home);
+    else
+    {
+        hist.fd = -2; // no file: history lives in memory only
+        return;
+    }
+    hist.base = (stat(hist.path, &st) == 0 && S_ISREG(st.st_mode)) ? st.st_size : 0;
+}
+
+/* histindex - Put entry id on the posting list of each bigram in it */
+static void histindex(int id)
+{
+    const unsigned char *s = (const unsigned char *)hist.entry[id].s;
+    int i;
+
+    for (i = 0; i + 1 < hist.entry[id].len; i++)
+    {
+        struct posting_t *list = &hist.bigram[s[i] << 8 | s[i + 1]];
+
+        if (list->n > 0 && list->id[list->n - 1] == id) // repeated in this entry
+            continue;
+        if (list->n == list->cap)
+        {
+            int cap = list->cap ? 2 * list->cap : 4;
+            int *ids = realloc(list->id, cap * sizeof(int));
+
+            if (ids == NULL)
+                app_error("histindex: out of memory");
+            list->id = ids;
+            list->cap = cap;
+        }
+        list->id[list->n++] = id;
+    }
+}
+
+/* histgrow - Make room for n more entries */
+static void histgrow(int n)
+{
+    if (hist.n + n > hist.cap)
+    {
+        int cap = hist.cap ? hist.cap : 1024;
+
+        while (cap < hist.n + n)
+            cap *= 2;
+        if ((hist.entry = realloc(hist.entry, cap * sizeof(*hist.entry))) == NULL)
+            app_error("histgrow: out of memory");
+        hist.cap = cap;
+    }
+}
+
+/* histload - Read the history file in front of this session's lines, once */
+static void histload(void)
+{
+    int fd, nfile = 0, nsession;
+    char *p, *end, *nl;
+
+    if (hist.loaded)
+        return;
+    hist.loaded = 1;
+    histinit();
+    if (hist.base == 0 || (fd = open(hist.path, O_RDONLY | O_CLOEXEC)) < 0)
+        return;
+    hist.map = mmap(NULL, hist.base, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (hist.map == MAP_FAILED)
+    {
+        hist.map = NULL;
+        return;
+    }
+    madvise(hist.map, hist.base, MADV_SEQUENTIAL);
+
+    for (p = hist.map, end = hist.map + hist.base; p < end; p = nl + 1)
+    {
+        if ((nl = memchr(p, '\n', end - p)) == NULL)
+            break; // a line still being written by another shell
+        nfile++;
+    }
+    nsession = hist.n;
+    histgrow(nfile);
+    memmove(hist.entry + nfile, hist.entry, nsession * sizeof(*hist.entry));
+    for (p = hist.map, hist.n = 0; hist.n < nfile; p = nl + 1)
+    {
+        nl = memchr(p, '\n', end - p);
+        hist.entry[hist.n].s = p;
+        hist.entry[hist.n++].len = nl - p;
+    }
+    hist.n += nsession;
+    edit.hist += nfile; // the line being edited moved up with the session's lines
+}
+
+/* histadd - Add line (with its '\n') to the history and the history file */
+void histadd(const char *line)
+{
+    int len = strlen(line) - 1;
+    char *copy;
+
+    if (len <= 0 || strspn(line, " ") == (size_t)len)
+        return;
+    if (hist.n > 0 && hist.entry[hist.n - 1].len == len && !memcmp(hist.entry[hist.n - 1].s, line, len))
+        return; // same as the line before
+    histinit();
+    if (hist.fd == -1 &&
+        (hist.fd = open(hist.path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0600)) < 0)
+        hist.fd = -2;
+    if (hist.fd >= 0)
+        write(hist.fd, line, len + 1); // one write: lines of other shells stay whole
+
+    if ((copy = malloc(len)) == NULL)
+        app_error("histadd: out of memory");
+    memcpy(copy, line, len);
+    histgrow(1);
+    hist.entry[hist.n].s = copy;
+    hist.entry[hist.n].len = len;
+    if (hist.bigram != NULL)
+        histindex(hist.n);
+    hist.n++;
+}
+
+/*
+ * histfind - Newest entry older than entry from that contains the qlen
+ *    bytes at q, or -1
+ */
+static int histfind(const char *q, int qlen, int from)
+{
+    struct posting_t *list = NULL;
+    int i, lo, hi;
+
+    if (qlen == 0)
+        return -1;
+    if (qlen == 1) // every entry is a candidate: scan
+    {
+        for (i = from - 1; i >= 0; i--)
+            if (memchr(hist.entry[i].s, q[0], hist.entry[i].len) != NULL)
+                return i;
+        return -1;
+    }
+
+    if (hist.bigram == NULL)
+    {
+        if ((hist.bigram = calloc(1 << 16, sizeof(struct posting_t))) == NULL)
+            app_error("histfind: out of memory");
+        for (i = 0; i < hist.n; i++)
+            histindex(i);
+    }
+    for (i = 0; i + 1 < qlen; i++)
+    {
+        struct posting_t *l = &hist.bigram[(unsigned char)q[i] << 8 | (unsigned char)q[i + 1]];
+
+        if (list == NULL || l->n < list->n)
+            list = l;
+    }
+
+    lo = 0; // first posting >= from
+    hi = list->n;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+
+        if (list->id[mid] < from)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    while (--lo >= 0)
+    {
+        i = list->id[lo];
+        if (memmem(hist.entry[i].s, hist.entry[i].len, q, qlen) != NULL)
+            return i;
+    }
+    return -1;
+}
+
+/*
+ * do_history - Execute the builtin history command
+ *
+ *     history       list the history, oldest first, numbered
+ *     history n     only the last n lines
+ */
+void do_history(char **argv)
+{
+    int i = 0;
+
+    histload();
+    if (argv[1] != NULL)
+    {
+        if (!isdigit((unsigned char)argv[1][0]))
+        {
+            printf("history: %s: numeric argument required\n", argv[1]);
+            return;
+        }
+        if ((i = hist.n - atoi(argv[1])) < 0)
+            i = 0;
+    }
+    for (; i < hist.n; i++)
+        printf("%5d  %.*s\n", i + 1, hist.entry[i].len, hist.entry[i].s);
+}
+
+/* rawoff - Give the terminal back the modes it had before rawon */
+static void rawoff(void)
+{
+    if (edit.raw)
+    {
+        tcsetattr(STDIN_FILENO, TCSADRAIN, &edit.cooked);
+        edit.raw = 0;
+    }
+}
+
+/*
+ * rawon - Put the terminal in raw mode: bytes as they are typed, no
+ *    echo, and ctrl-c / ctrl-z as keys rather than signals. Output
+ *    processing stays on, so job messages printed meanwhile keep their
+ *    \r\n. Returns -1 if stdin is not a terminal after all.
+ */
+static int rawon(void)
+{
+    static int registered = 0;
+    struct termios raw;
+
+    if (tcgetattr(STDIN_FILENO, &edit.cooked) < 0)
+        return -1;
+    if (!registered++)
+        atexit(rawoff); // quit and SIGQUIT leave through exit
+    raw = edit.cooked;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_cflag |= CS8;
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSADRAIN, &raw) < 0)
+        return -1;
+    edit.raw = 1;
+    return 0;
+}
+
+/* termcols - Width of the terminal */
+static int termcols(void)
+{
+    struct winsize ws;
+
+    if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) < 0 || ws.ws_col == 0)
+        return 80;
+    return ws.ws_col;
+}
+
+/*
+ * redraw - Draw the prompt and the line (or the search prompt and the
+ *    match) on the current terminal row with one write, scrolled
+ *    sideways so the cursor stays in view
+ */
+static void redraw(void)
+{
+    char head[2 * MAXLINE + 64], out[4 * MAXLINE + 128];
+    const char *text = edit.buf;
+    int len = edit.len, pos = edit.pos, cols = termcols(), hlen, off, n;
+
+    if (edit.searching)
+    {
+        hlen = snprintf(head, sizeof(head), "(%sreverse-i-search)`%.*s': ",
+                        edit.match < 0 && edit.qlen > 0 ? "failing " : "", edit.qlen, edit.query);
+        if (edit.match >= 0)
+        {
+            text = hist.entry[edit.match].s;
+            len = hist.entry[edit.match].len;
+            pos = (char *)memmem(text, len, edit.query, edit.qlen) - text;
+        }
+        else
+        {
+            len = pos = 0;
+        }
+    }
+    else
+    {
+        hlen = snprintf(head, sizeof(head), "%s", edit.prompt);
+    }
+
+    if (hlen >= cols)
+        hlen = cols - 1;
+    if ((off = hlen + pos - cols + 1) > 0) // cursor past the right edge
+    {
+        text += off;
+        len -= off;
+        pos -= off;
+    }
+    if (hlen + len > cols)
+        len = cols - hlen;
+    n = snprintf(out, sizeof(out), "\r%.*s%.*s\033[0K\r", hlen, head, len, text);
+    if (hlen + pos > 0)
+        n += snprintf(out + n, sizeof(out) - n, "\033[%dC", hlen + pos);
+    write(STDOUT_FILENO, out, n);
+}
+
+/*
+ * readkey - Next byte from the terminal, or -1 at end of input. Job
+ *    messages queued meanwhile are printed above the line being edited.
+ */
+static int readkey(void)
+{
+    struct pollfd pfd[2] = {{STDIN_FILENO, POLLIN, 0}, {notify_pipe[0], POLLIN, 0}};
+    unsigned char c;
+    char buf[64];
+
+    while (1)
+    {
+        if (poll(pfd, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        if (pfd[1].revents & POLLIN)
+        {
+            read(notify_pipe[0], buf, sizeof(buf));
+            write(STDOUT_FILENO, "\r\033[0K", 5);
+            drainevents();
+            fflush(stdout);
+            redraw();
+        }
+        if (pfd[0].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+            ssize_t n = read(STDIN_FILENO, &c, 1);
+
+            if (n == 1)
+                return c;
+            if (n < 0 && errno == EINTR)
+                continue;
+            return -1;
+        }
+    }
+}
+
+/*
+ * escapekey - Read the rest of an escape sequence (ESC [ x, ESC O x or
+ *    ESC [ n ~) and return the control key it stands for, 0 if none,
+ *    KEY_DEL for Delete or -1 at end of input
+ */
+static int escapekey(void)
+{
+    int a, b, c;
+
+    if ((a = readkey()) < 0 || (b = readkey()) < 0)
+        return -1;
+    if (a == '[' && isdigit(b))
+    {
+        if ((c = readkey()) < 0)
+            return -1;
+        if (c != '~')
+            return 0;
+        return (b == '1' || b == '7') ? 1 : (b == '4' || b == '8') ? 5 : (b == '3') ? KEY_DEL : 0;
+    }
+    if (a != '[' && a != 'O')
+        return 0;
+    switch (b)
+    {
+    case 'A': // up
+        return 16;
+    case 'B': // down
+        return 14;
+    case 'C': // right
+        return 6;
+    case 'D': // left
+        return 2;
+    case 'H': // Home
+        return 1;
+    case 'F': // End
+        return 5;
+    }
+    return 0;
+}
+
+/* setline - Replace the line being edited with the len bytes at s */
+static void setline(const char *s, int len)
+{
+    if (len > MAXLINE - 2)
+        len = MAXLINE - 2;
+    memcpy(edit.buf, s, len);
+    edit.buf[len] = '\0';
+    edit.len = edit.pos = len;
+}
+
+/* search - Handle key c in reverse-i-search; returns 1 if the search is over */
+static int search(int c)
+{
+    int from;
+
+    switch (c)
+    {
+    case 18: // ctrl-r: next older match
+        from = edit.match >= 0 ? edit.match : hist.n;
+        if (edit.qlen > 0 && (from = histfind(edit.query, edit.qlen, from)) >= 0)
+            edit.match = from;
+        return 0;
+    case 127: // backspace: shorter query, newest match again
+    case 8:
+        if (edit.qlen > 0)
+            edit.qlen--;
+        edit.match = histfind(edit.query, edit.qlen, hist.n);
+        return 0;
+    case 7: // ctrl-g: back to the line as it was
+        setline(edit.saved, strlen(edit.saved));
+        edit.searching = 0;
+        return 1;
+    default:
+        if (c >= 32 && c != 127 && edit.qlen < MAXLINE - 1)
+        {
+            edit.query[edit.qlen++] = c;
+            from = edit.match >= 0 ? edit.match + 1 : hist.n; // the match may still do
+            edit.match = histfind(edit.query, edit.qlen, from);
+            return 0;
+        }
+        if (edit.match >= 0) // any other key takes the match to edit it
+            setline(hist.entry[edit.match].s, hist.entry[edit.match].len);
+        edit.searching = 0;
+        return 1;
+    }
+}
+
+/* gohist - Show history entry hist (hist.n: the line being typed) */
+static void gohist(int to)
+{
+    if (to < 0 || to > hist.n || to == edit.hist)
+        return;
+    if (edit.hist == hist.n)
+        strcpy(edit.saved, edit.buf);
+    edit.hist = to;
+    if (to == hist.n)
+        setline(edit.saved, strlen(edit.saved));
+    else
+        setline(hist.entry[to].s, hist.entry[to].len);
+}
+
+/*
+ * editline - Read a command line into cmdline ('\n'-terminated, as
+ *    fgets would) with line editing: ^A ^E ^B ^F and the arrow, Home,
+ *    End keys move; ^H ^D Delete ^K ^U ^W delete; ^P ^N and up/down
+ *    walk the history; ^R searches it; ^L clears the screen; ^C drops
+ *    the line. Returns 0 at end of input (^D on an empty line).
+ */
+int editline(const char *prompt, char *cmdline)
+{
+    int c, i;
+
+    if (rawon() < 0)
+    {
+        printf("%s", prompt);
+        fflush(stdout);
+        return fgets(cmdline, MAXLINE, stdin) != NULL;
+    }
+    edit.prompt = prompt;
+    edit.len = edit.pos = 0;
+    edit.buf[0] = edit.saved[0] = '\0';
+    edit.searching = 0;
+    edit.hist = hist.n;
+    fflush(stdout);
+    redraw();
+
+    while ((c = readkey()) >= 0)
+    {
+        if (edit.searching && (!search(c) || c == 7))
+        { // any key search does not take ends it and is then handled below
+            redraw();
+            continue;
+        }
+        if (c == 27 && (c = escapekey()) < 0)
+            break;
+
+        switch (c)
+        {
+        case 13: // enter
+        case 10:
+            edit.pos = edit.len;
+            redraw();
+            write(STDOUT_FILENO, "\n", 1);
+            rawoff();
+            memcpy(cmdline, edit.buf, edit.len);
+            strcpy(cmdline + edit.len, "\n");
+            return 1;
+        case 3: // ctrl-c
+            write(STDOUT_FILENO, "^C\n", 3);
+            edit.len = edit.pos = 0;
+            edit.buf[0] = '\0';
+            edit.hist = hist.n;
+            break;
+        case 4: // ctrl-d: end of input on an empty line, else delete
+            if (edit.len == 0)
+            {
+                write(STDOUT_FILENO, "\n", 1);
+                rawoff();
+                return 0;
+            } /* fall through */
+        case KEY_DEL: // Delete
+            if (edit.pos < edit.len)
+            {
+                memmove(edit.buf + edit.pos, edit.buf + edit.pos + 1, edit.len - edit.pos);
+                edit.len--;
+            }
+            break;
+        case 127: // backspace
+        case 8:
+            if (edit.pos > 0)
+            {
+                memmove(edit.buf + edit.pos - 1, edit.buf + edit.pos, edit.len - edit.pos + 1);
+                edit.pos--;
+                edit.len--;
+            }
+            break;
+        case 1: // ctrl-a, Home
+            edit.pos = 0;
+            break;
+        case 5: // ctrl-e, End
+            edit.pos = edit.len;
+            break;
+        case 2: // ctrl-b, left
+            if (edit.pos > 0)
+                edit.pos--;
+            break;
+        case 6: // ctrl-f, right
+            if (edit.pos < edit.len)
+                edit.pos++;
+            break;
+        case 11: // ctrl-k: delete to the end
+            edit.buf[edit.len = edit.pos] = '\0';
+            break;
+        case 21: // ctrl-u: delete to the start
+            memmove(edit.buf, edit.buf + edit.pos, edit.len - edit.pos + 1);
+            edit.len -= edit.pos;
+            edit.pos = 0;
+            break;
+        case 23: // ctrl-w: delete the word before the cursor
+            for (i = edit.pos; i > 0 && edit.buf[i - 1] == ' '; i--)
+                ;
+            for (; i > 0 && edit.buf[i - 1] != ' '; i--)
+                ;
+            memmove(edit.buf + i, edit.buf + edit.pos, edit.len - edit.pos + 1);
+            edit.len -= edit.pos - i;
+            edit.pos = i;
+            break;
+        case 16: // ctrl-p, up
+            histload();
+            gohist(edit.hist - 1);
+            break;
+        case 14: // ctrl-n, down
+            gohist(edit.hist + 1);
+            break;
+        case 18: // ctrl-r
+            histload();
+            strcpy(edit.saved, edit.buf);
+            edit.searching = 1;
+            edit.qlen = 0;
+            edit.match = -1;
+            break;
+        case 12: // ctrl-l
+            write(STDOUT_FILENO, "\033[H\033[2J", 7);
+            break;
+        default: // typed characters go in; other control keys (tab, ^Z) do nothing
+            if (c >= 32 && edit.len < MAXLINE - 2)
+            {
+                memmove(edit.buf + edit.pos + 1, edit.buf + edit.pos, edit.len - edit.pos + 1);
+                edit.buf[edit.pos++] = c;
+                edit.len++;
+            }
+        }
+        redraw();
+    }
+
+    rawoff();
+    return 0;
+}
+/***********************************************
+ * end line editor and history
+ **********************************************/
+
 /***********************
  * Other helper routines
  ***********************/
@@ -743,10 +3105,12 @@ void listjobs(struct job_t *jobs)
  */
 void usage(void)
 {
-    printf("Usage: shell [-hvp]\n");
+    printf("Usage: shell [-hvp] [-j <n>] [script]\n");
     printf("   -h   print this message\n");
     printf("   -v   print additional diagnostic information\n");
     printf("   -p   do not emit a command prompt\n");
+    printf("   -j   run script (or stdin) lines n at a time, as independent jobs\n");
+    printf("   script  run this file instead of reading commands, then print timings\n");
     exit(1);
 }
 
@@ -0,0 +1,158 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * spawn_bench.c - process launch rate of fork + execve against vfork +
+ *     execve and posix_spawn, as the parent's address space grows
+ *
+ * build: gcc -O2 -o spawn_bench spawn_bench.c
+ * usage: ./spawn_bench [-n <spawns>] [-p <program>] [<MB> ...]
+ *
+ * For each size the parent first touches that many MB of heap, so fork
+ * has that many page-table entries to copy. Every launch runs <program>
+ * (default /bin/true) in a process group of its own with the parent's
+ * SIGCHLD block lifted, like eval in tsh, and waits for it.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+int sizes[] = {0, 64, 512, 2048}; // MB
+#define NSIZES (int)(sizeof(sizes) / sizeof(sizes[0]))
+
+static double now(void){
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+sigset_t prev_mask; // mask the children get, as prev_vector in eval
+
+static pid_t by_fork(char **argv){
+
+    pid_t pid = fork();
+
+    if(pid == 0){
+        setpgid(0, 0);
+        sigprocmask(SIG_SETMASK, &prev_mask, NULL);
+        execve(argv[0], argv, environ);
+        _exit(127);
+    }
+    return pid;
+}
+
+static pid_t by_vfork(char **argv){
+
+    pid_t pid = vfork();
+
+    if(pid == 0){ // only async-signal-safe calls and no returns from here
+        setpgid(0, 0);
+        sigprocmask(SIG_SETMASK, &prev_mask, NULL);
+        execve(argv[0], argv, environ);
+        _exit(127);
+    }
+    return pid;
+}
+
+static pid_t by_spawn(char **argv){
+
+    posix_spawnattr_t attr;
+    pid_t pid;
+
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK);
+    posix_spawnattr_setpgroup(&attr, 0);
+    posix_spawnattr_setsigmask(&attr, &prev_mask);
+    if(posix_spawn(&pid, argv[0], NULL, &attr, argv, environ) != 0){
+        pid = -1;
+    }
+    posix_spawnattr_destroy(&attr);
+    return pid;
+}
+
+struct{
+    pid_t (*launch)(char **argv);
+    const char *name;
+} methods[] = {
+    {by_fork, "fork+execve"},
+    {by_vfork, "vfork+execve"},
+    {by_spawn, "posix_spawn"},
+};
+#define NMETHODS (int)(sizeof(methods) / sizeof(methods[0]))
+
+int main(int argc, char **argv){
+
+    int n = 1000;
+    char *child[] = {"/bin/true", NULL};
+    int *size_list = sizes, nsizes = NSIZES;
+    sigset_t block;
+    int c;
+
+    while((c = getopt(argc, argv, "n:p:")) != -1){
+        switch(c){
+        case 'n':
+            n = atoi(optarg);
+            break;
+        case 'p':
+            child[0] = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n <spawns>] [-p <program>] [<MB> ...]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(optind < argc){
+        nsizes = argc - optind;
+        size_list = malloc(nsizes * sizeof(int));
+        for(int i = 0; i < nsizes; i++){
+            size_list[i] = atoi(argv[optind + i]);
+        }
+    }
+
+    sigemptyset(&block);
+    sigaddset(&block, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &block, &prev_mask);
+
+    printf("%8s %-14s %10s %10s\n", "MB", "method", "spawns/s", "us/spawn");
+    for(int s = 0; s < nsizes; s++){
+        size_t bytes = (size_t)size_list[s] << 20;
+        char *heap = bytes ? malloc(bytes) : NULL;
+
+        if(bytes && heap == NULL){
+            fprintf(stderr, "no memory for %d MB\n", size_list[s]);
+            continue;
+        }
+        for(size_t off = 0; off < bytes; off += 4096){ // map every page
+            heap[off] = 1;
+        }
+
+        for(int m = 0; m < NMETHODS; m++){
+            double start = now(), elapsed;
+
+            for(int i = 0; i < n; i++){
+                pid_t pid = methods[m].launch(child);
+                int status;
+
+                if(pid < 0 || waitpid(pid, &status, 0) < 0 ||
+                   !WIFEXITED(status) || WEXITSTATUS(status) == 127){
+                    fprintf(stderr, "%s: could not run %s\n", methods[m].name, child[0]);
+                    return 1;
+                }
+            }
+            elapsed = now() - start;
+            printf("%8d %-14s %10.0f %10.1f\n", size_list[s], methods[m].name,
+                   n / elapsed, elapsed / n * 1e6);
+        }
+        free(heap);
+    }
+    return 0;
+}
@@ -0,0 +1,148 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * tsh_bench.c - per-command latency of tsh: runs thousands of short
+ *     foreground commands through one shell and times each of them
+ *
+ * build: gcc -O2 -o tsh 20220124_tsh.c && gcc -O2 -o tsh_bench tsh_bench.c
+ * usage: ./tsh_bench [-n <commands>] [-s <shell>] [-c <command>]
+ *
+ * The shell runs with -p on a pipe. Each command is written only after
+ * the output of the one before it has come back, and every command ends
+ * with a marker line, so one sample covers writing the line, parsing,
+ * launching, the child's run and waitfg noticing that it finished (the
+ * next command cannot start before the shell reads it).
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAXLINE 1024
+
+static double now(void){
+
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int cmp_double(const void *a, const void *b){
+
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return (x > y) - (x < y);
+}
+
+/*
+ * read_marker - read from fd until a line equal to "tsh_bench\n" has
+ *     come through, returns 0 or -1 on EOF
+ */
+static int read_marker(int fd){
+
+    static char buf[MAXLINE];
+    static int len = 0;
+    char *nl;
+
+    while(1){
+        while((nl = memchr(buf, '\n', len)) != NULL){
+            int line = nl - buf + 1;
+            int hit = (line == 10 && !memcmp(buf, "tsh_bench\n", 10));
+
+            memmove(buf, buf + line, len - line);
+            len -= line;
+            if(hit){
+                return 0;
+            }
+        }
+        if(len == MAXLINE){ // overlong line, nothing to match in it
+            len = 0;
+        }
+
+        int got = read(fd, buf + len, MAXLINE - len);
+        if(got <= 0){
+            return -1;
+        }
+        len += got;
+    }
+}
+
+int main(int argc, char **argv){
+
+    int n = 2000;
+    const char *shell = "./tsh";
+    const char *command = "/bin/echo tsh_bench";
+    int to_shell[2], from_shell[2];
+    char line[MAXLINE];
+    double *lat, start, total;
+    pid_t pid;
+    int c;
+
+    while((c = getopt(argc, argv, "n:s:c:")) != -1){
+        switch(c){
+        case 'n':
+            n = atoi(optarg);
+            break;
+        case 's':
+            shell = optarg;
+            break;
+        case 'c': // must print the line "tsh_bench" last
+            command = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n <commands>] [-s <shell>] [-c <command>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if(n <= 0 || (lat = malloc(n * sizeof(double))) == NULL){
+        fprintf(stderr, "bad command count\n");
+        return 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    if(pipe(to_shell) < 0 || pipe(from_shell) < 0){
+        perror("pipe");
+        return 1;
+    }
+    if((pid = fork()) == 0){
+        dup2(to_shell[0], 0);
+        dup2(from_shell[1], 1);
+        close(to_shell[0]);
+        close(to_shell[1]);
+        close(from_shell[0]);
+        close(from_shell[1]);
+        execl(shell, shell, "-p", (char *)NULL);
+        perror(shell);
+        _exit(1);
+    }
+    close(to_shell[0]);
+    close(from_shell[1]);
+
+    snprintf(line, sizeof(line), "%s\n", command);
+    total = now();
+    for(int i = 0; i < n; i++){
+        start = now();
+        if(write(to_shell[1], line, strlen(line)) < 0 || read_marker(from_shell[0]) < 0){
+            fprintf(stderr, "shell went away after %d commands\n", i);
+            return 1;
+        }
+        lat[i] = now() - start;
+    }
+    total = now() - total;
+
+    close(to_shell[1]); // EOF: tsh exits
+    waitpid(pid, NULL, 0);
+
+    qsort(lat, n, sizeof(double), cmp_double);
+    printf("%d commands in %.3f s, %.0f commands/s\n", n, total, n / total);
+    printf("latency us: min %.1f  median %.1f  p99 %.1f  max %.1f\n",
+           lat[0] * 1e6, lat[n / 2] * 1e6, lat[n * 99 / 100] * 1e6, lat[n - 1] * 1e6);
+
+    free(lat);
+    return 0;
+}
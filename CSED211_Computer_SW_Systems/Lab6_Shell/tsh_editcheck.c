@@ -0,0 +1,164 @@
+/* 20220124 Moonkyeom Kim
+ *
+ * tsh_editcheck.c - drives tsh's line editor through a pseudo-terminal
+ *     and checks that history keys reach the history file's lines
+ *
+ * build: gcc -O2 -o tsh 20220124_tsh.c && gcc -O2 -o tsh_editcheck tsh_editcheck.c
+ * usage: ./tsh_editcheck [-s <shell>]
+ *
+ * Every case starts a fresh shell whose history file holds "echo OLD1"
+ * and "echo OLD2", so the first history key is the one that loads the
+ * file: its lines go in front of the ones typed in this session, and the
+ * line being edited must still be the one after the newest of them. A
+ * case types its keys a line at a time, each after the shell's prompt,
+ * and passes if the output the last line should give comes back.
+ */
+#define _GNU_SOURCE // posix_openpt, ptsname
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#define MAXOUT 65536
+#define UP "\033[A"
+#define DOWN "\033[B"
+
+struct{
+    const char *name;
+    const char *keys[4]; // lines typed, each after a prompt
+    const char *expect;  // output line the last of them gives
+} cases[] = {
+    {"up in a fresh shell", {UP "\r"}, "\nOLD2\r\n"},
+    {"up after a command", {"echo NEW\r", "abc" UP UP "\r"}, "\nOLD2\r\n"},
+    {"up, down keeps the typed line", {"echo NEW\r", "echo abc" UP DOWN "\r"}, "\nabc\r\n"},
+    {"^R after a command", {"echo NEW\r", "\022OLD1\r"}, "\nOLD1\r\n"},
+};
+#define NCASES (int)(sizeof(cases) / sizeof(cases[0]))
+
+static char out[MAXOUT];
+static int outlen;
+
+/*
+ * read_until - read from fd until text appears at or after out[from],
+ *     returns the offset just past it, or -1 on EOF or a 2 s silence
+ */
+static int read_until(int fd, const char *text, int from){
+
+    struct pollfd p = {fd, POLLIN, 0};
+    char *hit;
+
+    while(1){
+        out[outlen] = '\0';
+        if(from <= outlen && (hit = strstr(out + from, text)) != NULL){
+            return hit - out + strlen(text);
+        }
+        if(outlen == MAXOUT - 1 || poll(&p, 1, 2000) <= 0){
+            return -1;
+        }
+
+        int got = read(fd, out + outlen, MAXOUT - 1 - outlen);
+        if(got <= 0){ // EIO once the shell has closed the terminal
+            return -1;
+        }
+        outlen += got;
+    }
+}
+
+/*run_case - 0 if case c gives its expected output*/
+static int run_case(int c, const char *shell, const char *histfile){
+
+    int master, at, i, ok = 0;
+    FILE *f;
+    pid_t pid;
+
+    if((f = fopen(histfile, "w")) == NULL){
+        perror(histfile);
+        return -1;
+    }
+    fputs("echo OLD1\necho OLD2\n", f);
+    fclose(f);
+
+    if((master = posix_openpt(O_RDWR | O_NOCTTY)) < 0 || grantpt(master) < 0 ||
+       unlockpt(master) < 0){
+        perror("posix_openpt");
+        return -1;
+    }
+    if((pid = fork()) == 0){
+        int slave;
+
+        setsid(); // the pty becomes the controlling terminal
+        if((slave = open(ptsname(master), O_RDWR)) < 0){
+            _exit(1);
+        }
+        dup2(slave, 0);
+        dup2(slave, 1);
+        dup2(slave, 2);
+        close(slave);
+        close(master);
+        setenv("TSH_HISTORY", histfile, 1);
+        setenv("TERM", "xterm", 1);
+        execl(shell, shell, (char *)NULL);
+        _exit(1);
+    }
+
+    outlen = 0;
+    at = read_until(master, "tsh> ", 0);
+    for(i = 0; i < 4 && cases[c].keys[i] != NULL && at >= 0; i++){
+        int last = (i == 3 || cases[c].keys[i + 1] == NULL);
+
+        write(master, cases[c].keys[i], strlen(cases[c].keys[i]));
+        if(last){
+            ok = read_until(master, cases[c].expect, at) >= 0;
+            break;
+        }
+        // the next prompt comes after the line's output, not just a redraw
+        at = read_until(master, "\n\rtsh> ", at);
+    }
+
+    write(master, "\025quit\r", 6);
+    close(master);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char **argv){
+
+    const char *shell = "./tsh";
+    char histfile[] = "/tmp/tsh_editcheckXXXXXX";
+    int c, fd, failed = 0;
+
+    while((c = getopt(argc, argv, "s:")) != -1){
+        switch(c){
+        case 's':
+            shell = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-s <shell>]\n", argv[0]);
+            return 1;
+        }
+    }
+    if((fd = mkstemp(histfile)) < 0){
+        perror("mkstemp");
+        return 1;
+    }
+    close(fd);
+
+    signal(SIGPIPE, SIG_IGN);
+    for(c = 0; c < NCASES; c++){
+        int r = run_case(c, shell, histfile);
+
+        printf("%-32s %s\n", cases[c].name, r == 0 ? "ok" : "FAIL");
+        if(r != 0){
+            failed++;
+        }
+    }
+    unlink(histfile);
+    return failed != 0;
+}